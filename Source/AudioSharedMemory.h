@@ -23,13 +23,19 @@ public:
   // but we will keep the read/write heads tight.
   static constexpr size_t kBufferCapacity = 8192;
   static constexpr size_t kNumChannels = 2; // Stereo for now
+  // Bumped whenever SharedState changes layout, so a stale consumer never
+  // reads a mapping it doesn't understand.
+  static constexpr uint64_t kMagic = 0xF1DD1E00A0D10001;
 
   // The exact layout of the shared memory file
   struct SharedState {
-    std::atomic<uint64_t> magic;      // 0xF1DD1E00A0D10000
+    std::atomic<uint64_t> magic;      // kMagic
     std::atomic<uint64_t> writeIndex; // Number of samples written
     std::atomic<uint64_t> readIndex;  // Number of samples read
     std::atomic<double> sampleRate;   // Currently active sample rate
+    // Everything written before this index is stale (transport stop/locate).
+    // The consumer skips its read head forward to it.
+    std::atomic<uint64_t> flushIndex;
 
     // Interleaved floating point audio data [L, R, L, R...]
     // Because std::atomic float operations aren't standard cross-process
@@ -95,15 +101,16 @@ public:
         state->writeIndex.store(0, std::memory_order_relaxed);
         state->readIndex.store(0, std::memory_order_relaxed);
         state->sampleRate.store(44100.0, std::memory_order_relaxed);
+        state->flushIndex.store(0, std::memory_order_relaxed);
         // Set magic number to indicate initialization is complete
-        state->magic.store(0xF1DD1E00A0D10000, std::memory_order_release);
+        state->magic.store(kMagic, std::memory_order_release);
       }
     }
   }
 
   bool isReady() const {
     return state != nullptr &&
-           state->magic.load(std::memory_order_acquire) == 0xF1DD1E00A0D10000;
+           state->magic.load(std::memory_order_acquire) == kMagic;
   }
 
   /// Re-open the memory-mapped file. Call this on the consumer side when the
@@ -161,6 +168,13 @@ public:
     uint64_t writePos = state->writeIndex.load(std::memory_order_relaxed);
     uint64_t readPos = state->readIndex.load(std::memory_order_acquire);
 
+    // Mark everything already in the ring as stale. Done here rather than in
+    // flush() so the mark lands on a block boundary of the audio thread.
+    if (flushRequested.exchange(false, std::memory_order_acq_rel)) {
+      state->flushIndex.store(writePos, std::memory_order_release);
+      readPos = writePos; // the consumer will skip to here
+    }
+
     // Check available space
     if (writePos - readPos + numSamples > kBufferCapacity) {
       // Buffer Overflow/Underrun. Consumer is too slow.
@@ -181,6 +195,30 @@ public:
     state->writeIndex.store(writePos + numSamples, std::memory_order_release);
   }
 
+  /**
+   * Frames pushAudio() can accept right now. Used by the offline renderer,
+   * which waits for space instead of dropping blocks.
+   */
+  int getFreeSpace() const {
+    if (!isReady() || !producer)
+      return 0;
+    if (flushRequested.load(std::memory_order_acquire))
+      return (int)kBufferCapacity;
+
+    uint64_t writePos = state->writeIndex.load(std::memory_order_relaxed);
+    uint64_t readPos = state->readIndex.load(std::memory_order_acquire);
+    uint64_t flushPos = state->flushIndex.load(std::memory_order_relaxed);
+    if (readPos < flushPos)
+      readPos = flushPos;
+    return (int)(kBufferCapacity - (writePos - readPos));
+  }
+
+  /**
+   * Discard all audio that has been written but not yet read. Safe to call
+   * from any thread; takes effect at the next pushAudio().
+   */
+  void flush() { flushRequested.store(true, std::memory_order_release); }
+
   void setSampleRate(double sampleRate) {
     if (isReady() && producer) {
       state->sampleRate.store(sampleRate, std::memory_order_relaxed);
@@ -207,6 +245,9 @@ public:
 
     uint64_t writePos = state->writeIndex.load(std::memory_order_acquire);
     uint64_t readPos = state->readIndex.load(std::memory_order_relaxed);
+    uint64_t flushPos = state->flushIndex.load(std::memory_order_acquire);
+    if (readPos < flushPos)
+      readPos = flushPos;
 
     uint64_t available = writePos - readPos;
 
@@ -241,6 +282,7 @@ public:
 
 private:
   bool producer;
+  std::atomic<bool> flushRequested{false};
   std::unique_ptr<MemoryMappedFile> memoryMap;
   SharedState *state = nullptr;
 };
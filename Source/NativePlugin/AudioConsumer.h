@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -10,6 +11,7 @@
 #include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <thread>
 #include <unistd.h>
 
 namespace fiddle {
@@ -19,23 +21,25 @@ namespace fiddle {
  * Reads audio produced by FiddleServer (AudioSharedMemory producer).
  *
  * The memory layout MUST match AudioSharedMemory::SharedState exactly:
- *   - magic:      std::atomic<uint64_t>  (0xF1DD1E00A0D10000 when ready)
+ *   - magic:      std::atomic<uint64_t>  (kMagic when ready)
  *   - writeIndex: std::atomic<uint64_t>
  *   - readIndex:  std::atomic<uint64_t>
  *   - sampleRate: std::atomic<double>
+ *   - flushIndex: std::atomic<uint64_t>  (audio before this index is stale)
  *   - audioData:  float[kBufferCapacity * kNumChannels]  (interleaved L,R)
  */
 class AudioConsumer {
 public:
   static constexpr size_t kBufferCapacity = 8192;
   static constexpr size_t kNumChannels = 2;
-  static constexpr uint64_t kMagic = 0xF1DD1E00A0D10000;
+  static constexpr uint64_t kMagic = 0xF1DD1E00A0D10001;
 
   struct SharedState {
     std::atomic<uint64_t> magic;
     std::atomic<uint64_t> writeIndex;
     std::atomic<uint64_t> readIndex;
     std::atomic<double> sampleRate;
+    std::atomic<uint64_t> flushIndex;
     float audioData[kBufferCapacity * kNumChannels];
   };
 
@@ -68,6 +72,9 @@ public:
 
     uint64_t writePos = state_->writeIndex.load(std::memory_order_acquire);
     uint64_t readPos = state_->readIndex.load(std::memory_order_relaxed);
+    uint64_t flushPos = state_->flushIndex.load(std::memory_order_acquire);
+    if (readPos < flushPos)
+      readPos = flushPos; // Server flushed the ring (transport stop/locate)
     uint64_t available = writePos - readPos;
     int samplesToRead = static_cast<int>(
         available < static_cast<uint64_t>(numSamples) ? available : numSamples);
@@ -96,6 +103,30 @@ public:
     state_->readIndex.store(readPos + samplesToRead, std::memory_order_release);
   }
 
+  /// Block until numSamples frames are buffered or timeoutMs elapses. Only
+  /// for offline processing, where the host waits for process() to return.
+  /// Returns false on timeout (the caller then pads with silence as usual).
+  bool waitForAudio(int numSamples, int timeoutMs) {
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (isReady() && available() < static_cast<uint64_t>(numSamples)) {
+      if (std::chrono::steady_clock::now() >= deadline)
+        return false;
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return isReady();
+  }
+
+  /// Drop everything currently buffered. Called on transport stop/locate so
+  /// the host goes silent without waiting for the server round trip.
+  /// Only moves the read head, which this side owns.
+  void flush() {
+    if (!isReady())
+      return;
+    state_->readIndex.store(state_->writeIndex.load(std::memory_order_acquire),
+                            std::memory_order_release);
+  }
+
   /// Read the playback delay (ms) from active_config.txt line 2.
   /// Returns 1000 if not found.
   static int readActiveDelay() {
@@ -116,6 +147,15 @@ public:
   }
 
 private:
+  uint64_t available() const {
+    uint64_t writePos = state_->writeIndex.load(std::memory_order_acquire);
+    uint64_t readPos = state_->readIndex.load(std::memory_order_relaxed);
+    uint64_t flushPos = state_->flushIndex.load(std::memory_order_acquire);
+    if (readPos < flushPos)
+      readPos = flushPos;
+    return writePos - readPos;
+  }
+
   SharedState *state_ = nullptr;
   void *mappedMem_ = nullptr;
   size_t mappedSize_ = 0;
@@ -72,6 +72,7 @@ tresult PLUGIN_API FiddleProcessor::setBusArrangements(
 
 tresult PLUGIN_API FiddleProcessor::setupProcessing(ProcessSetup &setup) {
   cachedSampleRate_ = setup.sampleRate;
+  offline_ = setup.processMode == kOffline;
 
   // Report initial latency from active_config.txt
   lastKnownDelayMs_ = AudioConsumer::readActiveDelay();
@@ -119,6 +120,7 @@ tresult PLUGIN_API FiddleProcessor::setActive(TBool state) {
 
     // Reset transport tracking
     wasPlaying_ = false;
+    nextHostSamples_ = -1;
   } else {
     tcpRelay_.reset();
   }
@@ -130,13 +132,11 @@ tresult PLUGIN_API FiddleProcessor::setActive(TBool state) {
 tresult PLUGIN_API FiddleProcessor::process(ProcessData &data) {
   // AUDIO THREAD — no blocking operations (no file I/O, no allocation,
   // no unbounded locks). pushMessage() uses a short mutex lock to enqueue.
+  // Offline export is the exception: there we wait for the server below.
 
   // Pull audio from FiddleServer via shared memory
-  if (data.numOutputs > 0 && data.outputs[0].numChannels > 0) {
-    audioConsumer_.pullAudio(data.outputs[0].channelBuffers32,
-                             data.outputs[0].numChannels, data.numSamples);
-    data.outputs[0].silenceFlags = 0;
-  }
+  if (!offline_)
+    pullOutput(data);
 
   // Poll for delay changes (check every ~1 second)
   delayPollCounter_ += data.numSamples;
@@ -153,10 +153,12 @@ tresult PLUGIN_API FiddleProcessor::process(ProcessData &data) {
   // Get host position (needed by both parameter changes and event processing)
   int64 hostSamples = 0;
   bool isPlaying = false;
+  bool hostPositionValid = false;
   if (data.processContext) {
     if (data.processContext->state & ProcessContext::kPlaying)
       isPlaying = true;
     if (data.processContext->state & ProcessContext::kProjectTimeMusicValid) {
+      hostPositionValid = true;
       hostSamples = data.processContext->projectTimeSamples;
       if (hostSamples < 0)
         hostSamples = 0; // Prevent uint64_t overflow
@@ -251,24 +253,55 @@ tresult PLUGIN_API FiddleProcessor::process(ProcessData &data) {
     }
   }
 
-  // Detect transport start
-  if (isPlaying && !wasPlaying_ && tcpRelay_) {
-    MidiEvent transportEvent;
-    transportEvent.set_timestamp_samples(0);
-    transportEvent.set_host_sample_position(static_cast<uint64_t>(hostSamples));
-
-    auto *transport = transportEvent.mutable_transport();
-    transport->set_type(MidiEvent_TransportEvent_Type_START);
-    transport->set_host_sample_position(static_cast<uint64_t>(hostSamples));
-
-    tcpRelay_->pushMessage(transportEvent);
+  // Detect transport start, stop and locate. On stop/locate we also drop
+  // whatever is buffered locally; the server flushes its side when the
+  // event arrives.
+  if (tcpRelay_) {
+    if (isPlaying && !wasPlaying_) {
+      if (offline_)
+        audioConsumer_.flush();
+      offlineStalled_ = false; // Give the server another chance
+      sendTransportEvent(MidiEvent_TransportEvent_Type_START, hostSamples);
+    } else if (!isPlaying && wasPlaying_) {
+      audioConsumer_.flush();
+      sendTransportEvent(MidiEvent_TransportEvent_Type_STOP, hostSamples);
+    } else if (isPlaying && hostPositionValid && nextHostSamples_ >= 0 &&
+               hostSamples != nextHostSamples_) {
+      audioConsumer_.flush();
+      sendTransportEvent(MidiEvent_TransportEvent_Type_LOCATE, hostSamples);
+    }
   }
   wasPlaying_ = isPlaying;
+  nextHostSamples_ =
+      (isPlaying && hostPositionValid) ? hostSamples + data.numSamples : -1;
 
   // Process MIDI events from input event list
   if (data.inputEvents)
     processEvents(data.inputEvents, hostSamples);
 
+  // Offline: tell the server it has every event for this block, then wait
+  // for the audio the host expects back (latencySamples_ behind). Once a
+  // wait times out the server is taken to be gone: later blocks only take
+  // what is already there, until audio turns up again or the next start,
+  // so a dead server costs one timeout rather than one per block.
+  if (offline_) {
+    if (tcpRelay_ && isPlaying) {
+      sendTransportEvent(MidiEvent_TransportEvent_Type_PROGRESS,
+                         hostSamples + data.numSamples);
+      const bool ready = audioConsumer_.waitForAudio(
+          data.numSamples, offlineStalled_ ? 0 : kOfflineTimeoutMs);
+      if (ready == offlineStalled_) {
+        offlineStalled_ = !ready;
+        pluginLog(ready ? std::string("Offline export: audio resumed")
+                        : "Offline export: no audio from FiddleServer after " +
+                              std::to_string(kOfflineTimeoutMs) +
+                              " ms; exporting silence");
+        sendConnectionStatus(ready);
+      }
+    }
+    pullOutput(data);
+  }
+
   // If program state changed this buffer, push to controller for UI.
   // This calls allocateMessage/sendMessage which allocate, but since this
   // plugin outputs silence (no audio synthesis), the overhead is acceptable.
@@ -396,6 +429,33 @@ void FiddleProcessor::processEvents(IEventList *events, int64 hostSamples) {
   }
 }
 
+//----------------------------------------------------------------------
+void FiddleProcessor::sendTransportEvent(MidiEvent_TransportEvent_Type type,
+                                         int64 hostSamples) {
+  MidiEvent transportEvent;
+  transportEvent.set_timestamp_samples(0);
+  transportEvent.set_host_sample_position(static_cast<uint64_t>(hostSamples));
+
+  auto *transport = transportEvent.mutable_transport();
+  transport->set_type(type);
+  transport->set_host_sample_position(static_cast<uint64_t>(hostSamples));
+  if (type == MidiEvent_TransportEvent_Type_START) {
+    transport->set_offline(offline_);
+    transport->set_latency_samples(latencySamples_);
+  }
+
+  tcpRelay_->pushMessage(transportEvent);
+}
+
+//----------------------------------------------------------------------
+void FiddleProcessor::pullOutput(ProcessData &data) {
+  if (data.numOutputs > 0 && data.outputs[0].numChannels > 0) {
+    audioConsumer_.pullAudio(data.outputs[0].channelBuffers32,
+                             data.outputs[0].numChannels, data.numSamples);
+    data.outputs[0].silenceFlags = 0;
+  }
+}
+
 //----------------------------------------------------------------------
 void FiddleProcessor::replayProgramState() {
   // Called from the relay thread when the TCP connection is established.
@@ -64,6 +64,9 @@ private:
   void processEvents(Steinberg::Vst::IEventList *events,
                      Steinberg::int64 hostSamples);
   void replayProgramState();
+  void sendTransportEvent(MidiEvent_TransportEvent_Type type,
+                          Steinberg::int64 hostSamples);
+  void pullOutput(Steinberg::Vst::ProcessData &data);
 
   // 16 event input buses (ports), 16 channels each = 256 total.
   // Dorico discovers the multi-port layout from the endpoint config.
@@ -86,6 +89,18 @@ private:
 
   bool wasPlaying_ = false;
 
+  // Host is exporting (processMode == kOffline). The server then renders on
+  // demand and process() waits for it instead of padding with silence.
+  bool offline_ = false;
+  static constexpr int kOfflineTimeoutMs = 2000;
+  // An offline wait timed out; stop waiting until audio arrives or the
+  // transport starts again.
+  bool offlineStalled_ = false;
+
+  // Host position expected at the start of the next block while playing.
+  // A mismatch means the host located (cycle, click-to-locate).
+  Steinberg::int64 nextHostSamples_ = -1;
+
   // Set by process() when a program change is received, cleared after
   // sending update to controller. Checked by connection callback timer.
   std::atomic<bool> programStatesDirty_{false};
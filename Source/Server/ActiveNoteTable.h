@@ -0,0 +1,182 @@
+#pragma once
+
+#include "TrackedNote.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace fiddle {
+
+/**
+ * The note tracker's sounding notes, indexed by (port, channel, pitch).
+ *
+ * Notes live in a pool of slots that are reused as notes end, so steady
+ * playing allocates nothing. Every logical channel (port × channel) links
+ * its notes in start order, and every (channel, pitch) links the notes
+ * sounding on that pitch oldest first. A note-off finds its note in O(1),
+ * and a CC visits only the notes on its own channel, however many are held
+ * elsewhere.
+ */
+class ActiveNoteTable {
+public:
+  static constexpr int kNumPorts = 16;
+  static constexpr int kNumChannels = kNumPorts * 16; // logical channels
+  static constexpr uint32_t kNone = 0xffffffffu;
+
+  /// Logical channel for a protobuf port (0-based, as the plugin sends it)
+  /// and channel (1-16), or -1 where nothing routes: the same index as
+  /// MixerModel::routeIndex(port, channel - 1).
+  static int channelIndex(uint32_t port, uint32_t channel) {
+    if (port >= (uint32_t)kNumPorts || channel < 1 || channel > 16)
+      return -1;
+    return (int)port * 16 + (int)channel - 1;
+  }
+
+  ActiveNoteTable() {
+    channels_.fill({kNone, kNone});
+    pitches_.fill({kNone, kNone});
+    slots_.reserve(kInitialSlots);
+  }
+
+  /// Add a note on `channel` (a channelIndex()). Returns its slot.
+  uint32_t add(int channel, int pitch, const TrackedNote &note) {
+    const uint32_t slot = allocate();
+    auto &e = slots_[slot];
+    e.note = note;
+    e.channel = channel;
+    e.pitch = pitch & 0x7f;
+    e.used = true;
+    link(channels_[(size_t)channel], slot, &Entry::channelLink);
+    link(pitches_[pitchKey(channel, e.pitch)], slot, &Entry::pitchLink);
+    ++size_;
+    return slot;
+  }
+
+  /// Remove the note in `slot`. The slot is reused by a later add().
+  void remove(uint32_t slot) {
+    auto &e = slots_[slot];
+    unlink(channels_[(size_t)e.channel], slot, &Entry::channelLink);
+    unlink(pitches_[pitchKey(e.channel, e.pitch)], slot, &Entry::pitchLink);
+    e.used = false;
+    e.channelLink.next = free_;
+    free_ = slot;
+    --size_;
+  }
+
+  TrackedNote &note(uint32_t slot) { return slots_[slot].note; }
+  const TrackedNote &note(uint32_t slot) const { return slots_[slot].note; }
+
+  /// Oldest note sounding on this channel and pitch, or kNone.
+  uint32_t firstOnPitch(int channel, int pitch) const {
+    return pitches_[pitchKey(channel, pitch & 0x7f)].head;
+  }
+  /// The next newer note on the same pitch as `slot`, or kNone.
+  uint32_t nextOnPitch(uint32_t slot) const {
+    return slots_[slot].pitchLink.next;
+  }
+
+  /// Most recently started note on this channel, or kNone.
+  uint32_t newestOnChannel(int channel) const {
+    return channels_[(size_t)channel].tail;
+  }
+
+  /// Visit the notes on one channel, oldest first.
+  template <typename Fn> void forEachOnChannel(int channel, Fn &&fn) {
+    for (uint32_t s = channels_[(size_t)channel].head; s != kNone;
+         s = slots_[s].channelLink.next)
+      fn(slots_[s].note);
+  }
+
+  /// Visit every sounding note, in no particular order.
+  template <typename Fn> void forEach(Fn &&fn) const {
+    for (const auto &e : slots_)
+      if (e.used)
+        fn(e.note);
+  }
+
+  int size() const { return size_; }
+
+  /// Forget every note. Only the lists that are in use are reset, so this
+  /// stays cheap however large the index.
+  void clear() {
+    for (auto &e : slots_) {
+      if (!e.used)
+        continue;
+      channels_[(size_t)e.channel] = {kNone, kNone};
+      pitches_[pitchKey(e.channel, e.pitch)] = {kNone, kNone};
+      e.used = false;
+    }
+    free_ = kNone;
+    for (uint32_t s = (uint32_t)slots_.size(); s-- > 0;) {
+      slots_[s].channelLink.next = free_;
+      free_ = s;
+    }
+    size_ = 0;
+  }
+
+private:
+  static constexpr size_t kInitialSlots = 256;
+
+  struct Link {
+    uint32_t prev = kNone;
+    uint32_t next = kNone;
+  };
+  struct List {
+    uint32_t head;
+    uint32_t tail;
+  };
+  struct Entry {
+    TrackedNote note;
+    int channel = 0;
+    int pitch = 0;
+    bool used = false;
+    Link channelLink; // also the free list, while unused
+    Link pitchLink;
+  };
+
+  static size_t pitchKey(int channel, int pitch) {
+    return (size_t)channel * 128 + (size_t)pitch;
+  }
+
+  uint32_t allocate() {
+    if (free_ == kNone) {
+      slots_.emplace_back();
+      return (uint32_t)slots_.size() - 1;
+    }
+    const uint32_t slot = free_;
+    free_ = slots_[slot].channelLink.next;
+    return slot;
+  }
+
+  void link(List &list, uint32_t slot, Link Entry::*member) {
+    auto &l = slots_[slot].*member;
+    l.prev = list.tail;
+    l.next = kNone;
+    if (list.tail != kNone)
+      (slots_[list.tail].*member).next = slot;
+    else
+      list.head = slot;
+    list.tail = slot;
+  }
+
+  void unlink(List &list, uint32_t slot, Link Entry::*member) {
+    auto &l = slots_[slot].*member;
+    if (l.prev != kNone)
+      (slots_[l.prev].*member).next = l.next;
+    else
+      list.head = l.next;
+    if (l.next != kNone)
+      (slots_[l.next].*member).prev = l.prev;
+    else
+      list.tail = l.prev;
+    l = {};
+  }
+
+  std::vector<Entry> slots_;
+  uint32_t free_ = kNone;
+  int size_ = 0;
+  std::array<List, kNumChannels> channels_;
+  std::array<List, (size_t)kNumChannels * 128> pitches_;
+};
+
+} // namespace fiddle
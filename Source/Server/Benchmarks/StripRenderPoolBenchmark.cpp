@@ -0,0 +1,104 @@
+// Scaling benchmark for StripRenderPool: renders blocks of synthetic strips
+// of varied cost (a few heavy sample libraries, a divisi section of mid
+// weight, many light ones) at 0..N workers and prints the block times.
+//
+//   StripRenderPoolBenchmark [strips] [blocks]
+
+#include "StripRenderPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <juce_core/juce_core.h>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 512;
+
+/// Per-strip work in units of one inner loop; fixed seed, so every run of
+/// every worker count renders the same mix.
+std::vector<int> makeCosts(int strips) {
+  juce::Random random(1234);
+  std::vector<int> costs((size_t)strips);
+  for (int i = 0; i < strips; ++i) {
+    const float pick = random.nextFloat();
+    costs[(size_t)i] = pick < 0.1f   ? 40 + random.nextInt(40) // heavy
+                       : pick < 0.4f ? 10 + random.nextInt(10) // divisi
+                                     : 1 + random.nextInt(4);  // light
+  }
+  return costs;
+}
+
+/// Stand-in for a plugin's processBlock(): `cost` passes over a block.
+float renderStrip(int cost, float seed) {
+  float acc = seed;
+  for (int pass = 0; pass < cost; ++pass)
+    for (int i = 0; i < kBlockSize; ++i)
+      acc = acc * 0.999f + std::sin(acc + (float)i);
+  return acc;
+}
+
+struct Result {
+  double meanMs = 0.0;
+  double p99Ms = 0.0;
+};
+
+Result runBlocks(int workers, const std::vector<int> &costs, int blocks) {
+  fiddle::StripRenderPool pool(workers, kSampleRate, kBlockSize);
+  const int strips = (int)costs.size();
+  std::vector<float> estimates(costs.begin(), costs.end());
+  std::vector<float> outputs((size_t)strips);
+  auto job = [&](int i) {
+    outputs[(size_t)i] = renderStrip(costs[(size_t)i], (float)i);
+  };
+
+  for (int i = 0; i < 20; ++i) // Warm up: threads started and spinning
+    pool.run(strips, estimates.data(), job);
+
+  std::vector<double> times((size_t)blocks);
+  for (int b = 0; b < blocks; ++b) {
+    const auto start = juce::Time::getHighResolutionTicks();
+    pool.run(strips, estimates.data(), job);
+    times[(size_t)b] = 1000.0 * juce::Time::highResolutionTicksToSeconds(
+                                    juce::Time::getHighResolutionTicks() -
+                                    start);
+  }
+
+  Result r;
+  r.meanMs = std::accumulate(times.begin(), times.end(), 0.0) / blocks;
+  std::sort(times.begin(), times.end());
+  r.p99Ms = times[(size_t)std::min(blocks - 1, blocks * 99 / 100)];
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const int strips = argc > 1 ? juce::jlimit(1, 1024, std::atoi(argv[1])) : 64;
+  const int blocks = argc > 2 ? juce::jmax(1, std::atoi(argv[2])) : 500;
+  // Up to what MixerModel starts: one worker per core besides the calling
+  // thread, at most kMaxRenderWorkers
+  const int maxWorkers =
+      juce::jlimit(0, 15, juce::SystemStats::getNumCpus() - 1);
+  const auto costs = makeCosts(strips);
+
+  std::printf("[StripRenderPool] %d strips, %d blocks of %d samples "
+              "(%.2f ms at %.0f Hz)\n",
+              strips, blocks, kBlockSize, 1000.0 * kBlockSize / kSampleRate,
+              kSampleRate);
+  std::printf("%8s %10s %10s %8s\n", "workers", "mean ms", "p99 ms",
+              "speedup");
+
+  double serialMs = 0.0;
+  for (int workers = 0; workers <= maxWorkers; ++workers) {
+    const auto r = runBlocks(workers, costs, blocks);
+    if (workers == 0)
+      serialMs = r.meanMs;
+    std::printf("%8d %10.3f %10.3f %7.2fx\n", workers, r.meanMs, r.p99Ms,
+                serialMs / r.meanMs);
+  }
+  return 0;
+}
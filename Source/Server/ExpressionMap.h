@@ -306,6 +306,21 @@ public:
     return nullptr;
   }
 
+  /// Index into getDimensions() of the dimension a CC drives, or -1. The
+  /// index is the dimension's interned ID in tracked notes.
+  int getDimensionIndexForCC(int cc) const {
+    auto it = ccToDimensionIdx.find(cc);
+    return it != ccToDimensionIdx.end() ? it->second : -1;
+  }
+
+  /// Index into getDimensions() of the named dimension, or -1.
+  int findDimension(const juce::String &name) const {
+    for (size_t i = 0; i < dimensions.size(); ++i)
+      if (dimensions[i].name == name)
+        return (int)i;
+    return -1;
+  }
+
   /// Returns true if the given CC102 value (base switch) uses CC1 for dynamics.
   /// Returns false if it uses note velocity (or if the value is unknown).
   bool dynamicsUsesCC1(int cc102Value) const {
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <iostream>
 #include <juce_core/juce_core.h>
+#include <map>
 #include <yaml-cpp/yaml.h>
 
 namespace fiddle {
@@ -142,6 +143,56 @@ public:
     return 1000; // default
   }
 
+  /// A subnote policy as YAML: {duration_s, align_to_grid, watchdog_s}.
+  static YAML::Node subnotePolicyToYaml(const SubnotePolicy &policy) {
+    YAML::Node node;
+    node["duration_s"] = policy.durationSeconds;
+    node["align_to_grid"] = policy.alignToGrid;
+    node["watchdog_s"] = policy.watchdogSeconds;
+    return node;
+  }
+
+  /// A strip's override: only the keys it sets.
+  static YAML::Node subnoteOverrideToYaml(const SubnotePolicyOverride &o) {
+    YAML::Node node;
+    if (o.durationSeconds)
+      node["duration_s"] = *o.durationSeconds;
+    if (o.alignToGrid)
+      node["align_to_grid"] = *o.alignToGrid;
+    if (o.watchdogSeconds)
+      node["watchdog_s"] = *o.watchdogSeconds;
+    return node;
+  }
+
+  /// Read a strip's override; keys left out follow its family's policy.
+  static SubnotePolicyOverride subnoteOverrideFromYaml(const YAML::Node &node) {
+    SubnotePolicyOverride o;
+    if (!node.IsMap())
+      return o;
+    if (node["duration_s"])
+      o.durationSeconds = juce::jmax(0.01, node["duration_s"].as<double>());
+    if (node["align_to_grid"])
+      o.alignToGrid = node["align_to_grid"].as<bool>();
+    if (node["watchdog_s"])
+      o.watchdogSeconds = juce::jmax(1.0, node["watchdog_s"].as<double>());
+    return o;
+  }
+
+  /// Read a subnote policy; keys left out keep their value from `base`.
+  static SubnotePolicy subnotePolicyFromYaml(const YAML::Node &node,
+                                             SubnotePolicy base) {
+    if (!node.IsMap())
+      return base;
+    if (node["duration_s"])
+      base.durationSeconds =
+          juce::jmax(0.01, node["duration_s"].as<double>());
+    if (node["align_to_grid"])
+      base.alignToGrid = node["align_to_grid"].as<bool>();
+    if (node["watchdog_s"])
+      base.watchdogSeconds = juce::jmax(1.0, node["watchdog_s"].as<double>());
+    return base;
+  }
+
   static void save(const PluginScanner &scanner, const MixerModel &mixer,
                    const juce::File &targetFile) {
     YAML::Node root;
@@ -149,6 +200,15 @@ public:
     // Save playback delay
     root["playback_delay_ms"] = mixer.getPlaybackDelayMs();
 
+    // Save subnote policies: the default and per family here, per strip on
+    // the strips
+    const auto &policies = mixer.getSubnotePolicies();
+    root["subnote_policies"]["default"] =
+        subnotePolicyToYaml(policies.defaults);
+    for (const auto &[family, policy] : policies.families)
+      root["subnote_policies"]["families"][family.toStdString()] =
+          subnotePolicyToYaml(policy);
+
     // Save Plugin Scanner Cache
     if (auto xml = scanner.getKnownPluginList().createXml()) {
       root["plugin_cache"] = xml->createDocument(juce::String()).toStdString();
@@ -168,13 +228,28 @@ public:
           strip["inputChannel"] =
               static_cast<int>(obj->getProperty("inputChannel"));
           strip["pluginUid"] = static_cast<int>(obj->getProperty("pluginUid"));
+          strip["bypassed"] = static_cast<bool>(obj->getProperty("bypassed"));
+          strip["sandboxed"] =
+              static_cast<bool>(obj->getProperty("sandboxed"));
+          strip["gainDb"] = static_cast<float>(obj->getProperty("gainDb"));
+          strip["pan"] = static_cast<float>(obj->getProperty("pan"));
+          strip["muted"] = static_cast<bool>(obj->getProperty("muted"));
+          strip["soloed"] = static_cast<bool>(obj->getProperty("soloed"));
+          if (auto *sends = obj->getProperty("sends").getDynamicObject()) {
+            for (auto &send : sends->getProperties())
+              strip["sends"][send.name.toString().toStdString()] =
+                  static_cast<float>(send.value);
+          }
 
           // Store raw plugin state if loaded
           if (auto *mixerStrip = const_cast<MixerModel &>(mixer).getStrip(
                   strip["id"].as<std::string>().c_str())) {
-            if (mixerStrip->pluginInstance) {
+            if (!mixerStrip->subnotePolicy.empty())
+              strip["subnotes"] =
+                  subnoteOverrideToYaml(mixerStrip->subnotePolicy);
+            if (auto *plugin = mixerStrip->getPlugin()) {
               juce::MemoryBlock block;
-              mixerStrip->pluginInstance->getStateInformation(block);
+              plugin->getStateInformation(block);
               if (block.getSize() > 0) {
                 strip["state"] = block.toBase64Encoding().toStdString();
               }
@@ -186,6 +261,38 @@ public:
     }
     root["mixer_strips"] = stripsNode;
 
+    // Save Mixer Buses (family bus levels, effect returns and their plugins)
+    YAML::Node busesNode;
+    juce::var parsedBuses = juce::JSON::parse(mixer.busesToJson());
+    if (auto *arr = parsedBuses.getArray()) {
+      for (auto &v : *arr) {
+        if (auto *obj = v.getDynamicObject()) {
+          YAML::Node bus;
+          bus["id"] = obj->getProperty("id").toString().toStdString();
+          bus["name"] = obj->getProperty("name").toString().toStdString();
+          bus["kind"] = obj->getProperty("kind").toString().toStdString();
+          bus["family"] = obj->getProperty("family").toString().toStdString();
+          bus["outputBusId"] =
+              obj->getProperty("outputBusId").toString().toStdString();
+          bus["gainDb"] = static_cast<float>(obj->getProperty("gainDb"));
+          bus["muted"] = static_cast<bool>(obj->getProperty("muted"));
+          bus["effectUid"] = static_cast<int>(obj->getProperty("effectUid"));
+
+          if (auto *mixerBus = const_cast<MixerModel &>(mixer).getBus(
+                  obj->getProperty("id").toString())) {
+            if (auto *effect = mixerBus->getEffect()) {
+              juce::MemoryBlock block;
+              effect->getStateInformation(block);
+              if (block.getSize() > 0)
+                bus["state"] = block.toBase64Encoding().toStdString();
+            }
+          }
+          busesNode.push_back(bus);
+        }
+      }
+    }
+    root["mixer_buses"] = busesNode;
+
     juce::String fullPath = targetFile.getFullPathName();
     std::cerr << "[FiddleConfig] Writing YAML to: " << fullPath << std::endl;
 
@@ -220,6 +327,19 @@ public:
         mixer.setPlaybackDelayMs(root["playback_delay_ms"].as<int>());
       }
 
+      // Load subnote policies; a config without them gets the defaults
+      SubnotePolicies policies;
+      if (auto node = root["subnote_policies"]; node.IsMap()) {
+        policies.defaults =
+            subnotePolicyFromYaml(node["default"], policies.defaults);
+        if (node["families"].IsMap()) {
+          for (const auto &family : node["families"])
+            policies.families[family.first.as<std::string>()] =
+                subnotePolicyFromYaml(family.second, policies.defaults);
+        }
+      }
+      mixer.setSubnotePolicies(std::move(policies));
+
       // Load Scanner Cache
       if (root["plugin_cache"].IsDefined() && !root["plugin_cache"].IsNull()) {
         juce::String xmlStr = root["plugin_cache"].as<std::string>();
@@ -237,6 +357,65 @@ public:
         }
       }
 
+      // Load Mixer Buses first, so strip sends can find them. Return bus
+      // IDs are regenerated; busIds maps saved IDs to the new ones.
+      std::map<std::string, juce::String> busIds;
+      if (root["mixer_buses"].IsDefined() && root["mixer_buses"].IsSequence()) {
+        for (const auto &node : root["mixer_buses"]) {
+          auto savedId = node["id"].as<std::string>();
+          bool isReturn = node["kind"].as<std::string>() == "return";
+          juce::String busId =
+              isReturn ? mixer.addReturnBus()
+                       : mixer.addFamilyBus(node["family"].as<std::string>());
+          busIds[savedId] = busId;
+          mixer.setBusMix(busId,
+                          node["gainDb"] ? node["gainDb"].as<float>() : 0.0f,
+                          node["muted"] ? node["muted"].as<bool>() : false);
+          auto *bus = mixer.getBus(busId);
+          if (bus == nullptr)
+            continue;
+          if (isReturn && node["name"])
+            bus->name = node["name"].as<std::string>();
+
+          int eUid = node["effectUid"] ? node["effectUid"].as<int>() : 0;
+          if (eUid == 0)
+            continue;
+          juce::PluginDescription desc;
+          bool found = false;
+          for (const auto &d : scanner.getKnownPluginList().getTypes()) {
+            if (d.uniqueId == eUid) {
+              desc = d;
+              found = true;
+              break;
+            }
+          }
+          if (!found) {
+            logs.push_back("WARNING: Plugin UID " + juce::String(eUid) +
+                           " not found in scanner cache for bus " + bus->name);
+            continue;
+          }
+          juce::String stateBase64 =
+              node["state"] ? node["state"].as<std::string>() : "";
+          mixer.getLoadQueue().add(
+              bus->name, stateBase64, false, // In-process: serial
+              [&mixer, busId, desc](juce::MemoryBlock state,
+                                    PluginLoadQueue::Done done) {
+                mixer.loadBusEffect(busId, desc, std::move(done),
+                                    std::move(state));
+              });
+        }
+        // Outputs once every bus exists
+        for (const auto &node : root["mixer_buses"]) {
+          auto out = node["outputBusId"] ? node["outputBusId"].as<std::string>()
+                                         : std::string();
+          if (!out.empty() && busIds.count(out))
+            mixer.setBusOutput(busIds[node["id"].as<std::string>()],
+                               busIds[out]);
+        }
+        logs.push_back("Restored " + juce::String((int)busIds.size()) +
+                       " mixer buses.");
+      }
+
       // Load Mixer Strips
       if (root["mixer_strips"].IsDefined() && !root["mixer_strips"].IsNull()) {
         if (root["mixer_strips"].IsSequence()) {
@@ -247,8 +426,30 @@ public:
             juce::String newId = mixer.addStrip();
             if (auto *strip = mixer.getStrip(newId)) {
               strip->name = node["name"].as<std::string>();
-              strip->inputPort = node["inputPort"].as<int>();
-              strip->inputChannel = node["inputChannel"].as<int>();
+              strip->sandboxed =
+                  node["sandboxed"] ? node["sandboxed"].as<bool>() : false;
+              // Resolved over forFamily(strip->family) once the strip's
+              // family is known (MixerModel::resolveSubnotePolicies())
+              if (node["subnotes"])
+                strip->subnotePolicy =
+                    subnoteOverrideFromYaml(node["subnotes"]);
+              mixer.setStripInput(newId, node["inputPort"].as<int>(),
+                                  node["inputChannel"].as<int>());
+              if (node["bypassed"])
+                mixer.setStripBypass(newId, node["bypassed"].as<bool>());
+              mixer.setStripMix(
+                  newId, node["gainDb"] ? node["gainDb"].as<float>() : 0.0f,
+                  node["pan"] ? node["pan"].as<float>() : 0.0f,
+                  node["muted"] ? node["muted"].as<bool>() : false,
+                  node["soloed"] ? node["soloed"].as<bool>() : false);
+              if (node["sends"] && node["sends"].IsMap()) {
+                for (const auto &send : node["sends"]) {
+                  auto it = busIds.find(send.first.as<std::string>());
+                  if (it != busIds.end())
+                    mixer.setStripSend(newId, it->second,
+                                       send.second.as<float>());
+                }
+              }
 
               logs.push_back("Restored strip: " + strip->name +
                              " (Port: " + juce::String(strip->inputPort) +
@@ -269,17 +470,16 @@ public:
                 if (found) {
                   juce::String stateBase64 =
                       node["state"] ? node["state"].as<std::string>() : "";
-                  // Capture format manager safely
-                  strip->loadPlugin(
-                      desc, mixer.getFormatManager(),
-                      [strip, stateBase64](bool success) {
-                        if (success && stateBase64.isNotEmpty() &&
-                            strip->pluginInstance) {
-                          juce::MemoryBlock block;
-                          block.fromBase64Encoding(stateBase64);
-                          strip->pluginInstance->setStateInformation(
-                              block.getData(), (int)block.getSize());
-                        }
+                  // Queued: plugins come up in the background while the
+                  // rest of the app (and playback) runs. Only sandboxed
+                  // strips load in parallel, each in its own process;
+                  // in-process loads stay serial.
+                  mixer.getLoadQueue().add(
+                      strip->name, stateBase64, strip->sandboxed,
+                      [&mixer, newId, desc](juce::MemoryBlock state,
+                                            PluginLoadQueue::Done done) {
+                        mixer.loadStripPlugin(newId, desc, std::move(done),
+                                              std::move(state));
                       });
                 } else {
                   logs.push_back("WARNING: Plugin UID " + juce::String(pUid) +
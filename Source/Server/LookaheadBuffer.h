@@ -0,0 +1,228 @@
+#pragma once
+
+#include "ActiveNoteTable.h"
+#include "TrackedNote.h"
+#include "TransportClock.h"
+#include <array>
+#include <vector>
+
+namespace fiddle {
+
+/**
+ * The notes of the last playback delay or so, per channel, in start order:
+ * what the lookahead stage knows about the phrase around a note before that
+ * note is played.
+ *
+ * Notes are added as the tracker reports them (TrackerEventDispatcher's
+ * scanner) and are read by the handler, which sees each note one hold time
+ * later, once the notes that follow it have arrived. Each logical channel
+ * (port × channel) keeps a ring ordered by (startSample, id), so finding a
+ * note, or the notes after it, is a binary search: O(log n) in the notes
+ * held on that channel.
+ *
+ * Dispatcher thread only. Note references stay valid until the next call
+ * that adds or removes notes.
+ */
+class LookaheadBuffer {
+public:
+  /// Notes still unended this long after they started are let go anyway.
+  static constexpr double kMaxHoldSeconds = 30.0;
+
+  explicit LookaheadBuffer(const TransportClock &clock) : clock_(clock) {}
+
+  /// A note started: add it after the notes already held on its channel.
+  void noteStarted(const TrackedNote &note) {
+    const int channel = channelOf(note);
+    if (channel >= 0)
+      rings_[(size_t)channel].insert(note);
+  }
+
+  /// A held note changed (ended, or gained notation): refresh our copy,
+  /// keeping the phrase context worked out here.
+  void noteChanged(const TrackedNote &note) {
+    if (auto *held = find(note)) {
+      const auto in = held->transitionIn, out = held->transitionOut;
+      *held = note;
+      held->transitionIn = in;
+      held->transitionOut = out;
+    }
+  }
+
+  /// Our copy of `note`, or nullptr if it isn't held.
+  TrackedNote *find(const TrackedNote &note) {
+    const int channel = channelOf(note);
+    return channel >= 0 ? rings_[(size_t)channel].find(note) : nullptr;
+  }
+
+  /// Forget the notes on `note`'s channel that ended before it started,
+  /// keeping the one just before it for phrase context.
+  void retireBefore(const TrackedNote &note) {
+    const int channel = channelOf(note);
+    if (channel >= 0)
+      rings_[(size_t)channel].retireBefore(note,
+                                           clock_.samplesFor(kMaxHoldSeconds));
+  }
+
+  void clear() {
+    for (auto &ring : rings_)
+      ring.clear();
+  }
+
+  /// Visit up to `count` notes starting after `note` on its channel, in
+  /// start order.
+  template <typename Fn>
+  void forEachNext(const TrackedNote &note, int count, Fn &&fn) const {
+    const int channel = channelOf(note);
+    if (channel < 0)
+      return;
+    const auto &ring = rings_[(size_t)channel];
+    for (int i = ring.upperBound(note); i < ring.size() && count > 0;
+         ++i, --count)
+      fn(ring.at(i));
+  }
+
+  /// Visit the notes starting after `note` on its channel and within
+  /// `seconds` of its start, in start order.
+  template <typename Fn>
+  void forEachWithin(const TrackedNote &note, double seconds, Fn &&fn) const {
+    const int channel = channelOf(note);
+    if (channel < 0)
+      return;
+    const auto &ring = rings_[(size_t)channel];
+    const uint64_t end = note.startSample + clock_.samplesFor(seconds);
+    for (int i = ring.upperBound(note);
+         i < ring.size() && ring.at(i).startSample <= end; ++i)
+      fn(ring.at(i));
+  }
+
+  /// The next note on `note`'s channel, or nullptr if none has arrived.
+  const TrackedNote *next(const TrackedNote &note) const {
+    const int channel = channelOf(note);
+    if (channel < 0)
+      return nullptr;
+    const auto &ring = rings_[(size_t)channel];
+    const int i = ring.upperBound(note);
+    return i < ring.size() ? &ring.at(i) : nullptr;
+  }
+
+  /// The note before `note` on its channel, or nullptr.
+  const TrackedNote *previous(const TrackedNote &note) const {
+    return const_cast<LookaheadBuffer *>(this)->previous(note);
+  }
+  TrackedNote *previous(const TrackedNote &note) {
+    const int channel = channelOf(note);
+    if (channel < 0)
+      return nullptr;
+    auto &ring = rings_[(size_t)channel];
+    const int i = ring.lowerBound(note);
+    return i > 0 ? &ring.at(i - 1) : nullptr;
+  }
+
+  /// Notes held on `note`'s channel after it.
+  int countAfter(const TrackedNote &note) const {
+    const int channel = channelOf(note);
+    if (channel < 0)
+      return 0;
+    const auto &ring = rings_[(size_t)channel];
+    return ring.size() - ring.upperBound(note);
+  }
+
+private:
+  static int channelOf(const TrackedNote &note) {
+    return ActiveNoteTable::channelIndex(note.port, note.channel);
+  }
+
+  static bool before(const TrackedNote &a, const TrackedNote &b) {
+    return a.startSample != b.startSample ? a.startSample < b.startSample
+                                          : a.id < b.id;
+  }
+
+  /// One channel's notes in start order. Grows by doubling and is reused,
+  /// so steady playing allocates nothing.
+  class Ring {
+  public:
+    int size() const { return count_; }
+    const TrackedNote &at(int i) const { return slots_[index(i)]; }
+    TrackedNote &at(int i) { return slots_[index(i)]; }
+
+    /// First position not before `note`.
+    int lowerBound(const TrackedNote &note) const {
+      int lo = 0, hi = count_;
+      while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (before(at(mid), note))
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      return lo;
+    }
+    /// First position after `note`.
+    int upperBound(const TrackedNote &note) const {
+      int i = lowerBound(note);
+      if (i < count_ && at(i).id == note.id)
+        ++i;
+      return i;
+    }
+
+    TrackedNote *find(const TrackedNote &note) {
+      const int i = lowerBound(note);
+      return i < count_ && at(i).id == note.id ? &at(i) : nullptr;
+    }
+
+    void insert(const TrackedNote &note) {
+      if (count_ == (int)slots_.size())
+        grow();
+      // Nearly always an append; an early timestamp shifts a few notes up
+      int i = count_++;
+      for (; i > 0 && before(note, at(i - 1)); --i)
+        at(i) = at(i - 1);
+      at(i) = note;
+    }
+
+    void retireBefore(const TrackedNote &note, uint64_t maxAge) {
+      int keep = lowerBound(note) - 1; // The note just before `note`
+      for (; keep > 0; --keep) {
+        const auto &oldest = at(0);
+        const bool ended =
+            oldest.durationSamples > 0 &&
+            oldest.startSample + oldest.durationSamples <= note.startSample;
+        // A note that never ended can't hold up the ring for ever
+        const bool stale = oldest.startSample + maxAge < note.startSample;
+        if (!ended && !stale)
+          break; // Still sounding under `note`
+        head_ = (head_ + 1) & mask();
+        --count_;
+      }
+    }
+
+    void clear() {
+      head_ = 0;
+      count_ = 0;
+    }
+
+  private:
+    static constexpr size_t kInitialSize = 64;
+
+    size_t mask() const { return slots_.size() - 1; }
+    size_t index(int i) const { return (head_ + (size_t)i) & mask(); }
+
+    void grow() {
+      std::vector<TrackedNote> bigger(
+          slots_.empty() ? kInitialSize : slots_.size() * 2);
+      for (int i = 0; i < count_; ++i)
+        bigger[(size_t)i] = at(i);
+      slots_.swap(bigger);
+      head_ = 0;
+    }
+
+    std::vector<TrackedNote> slots_; // power-of-two size
+    size_t head_ = 0;
+    int count_ = 0;
+  };
+
+  const TransportClock &clock_;
+  std::array<Ring, ActiveNoteTable::kNumChannels> rings_;
+};
+
+} // namespace fiddle
@@ -1,6 +1,7 @@
 #include "ConfigChooserWindow.h"
 #include "FiddleConfig.h"
 #include "MainComponent.h"
+#include "PluginSandboxWorker.h"
 #include <juce_gui_extra/juce_gui_extra.h>
 
 #include <JuceHeader.h>
@@ -48,6 +49,18 @@ public:
   };
 
   void initialise(const juce::String &commandLine) override {
+    // Started by a sandboxed strip: host its one plugin, no window or config
+    if (commandLine.contains(kSandboxProcessId)) {
+#if JUCE_MAC
+      juce::Process::setDockIconVisible(false);
+#endif
+      sandboxWorker = std::make_unique<PluginSandboxWorker>();
+      if (!sandboxWorker->initialiseFromCommandLine(
+              commandLine, kSandboxProcessId, kSandboxPingTimeoutMs))
+        quit();
+      return;
+    }
+
     // Migrate legacy config if needed
     FiddleConfig::migrateLegacyConfig();
 
@@ -63,6 +76,7 @@ public:
   }
 
   void shutdown() override {
+    sandboxWorker.reset();
     configChooser.reset();
     mainWindow.reset();
   }
@@ -218,6 +232,7 @@ public:
 private:
   std::unique_ptr<MainWindow> mainWindow;
   std::unique_ptr<ConfigChooserWindow> configChooser;
+  std::unique_ptr<PluginSandboxWorker> sandboxWorker;
   juce::File activeConfigFile;
 };
 
@@ -365,6 +365,45 @@ MainComponent::MainComponent(const juce::File &configFile)
                     });
                     completion(true);
                   })
+              .withNativeFunction(
+                  "setStripMix",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 5) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String stripId = args[0].toString();
+                    float gainDb = (float)args[1];
+                    float pan = (float)args[2];
+                    bool muted = (bool)args[3];
+                    bool soloed = (bool)args[4];
+                    safeCallAsync(
+                        [this, stripId, gainDb, pan, muted, soloed]() {
+                          if (mixer_.setStripMix(stripId, gainDb, pan, muted,
+                                                 soloed))
+                            pushMixerState();
+                        });
+                    completion(true);
+                  })
+              .withNativeFunction(
+                  "setStripBypass",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 2) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String stripId = args[0].toString();
+                    bool bypass = (bool)args[1];
+                    safeCallAsync([this, stripId, bypass]() {
+                      if (mixer_.setStripBypass(stripId, bypass))
+                        pushMixerState();
+                    });
+                    completion(true);
+                  })
               .withNativeFunction(
                   "setStripInput",
                   [this](const juce::Array<juce::var> &args,
@@ -378,11 +417,8 @@ MainComponent::MainComponent(const juce::File &configFile)
                     int port = (int)args[1];
                     int channel = (int)args[2];
                     safeCallAsync([this, stripId, port, channel]() {
-                      if (auto *s = mixer_.getStrip(stripId)) {
-                        s->inputPort = port;
-                        s->inputChannel = channel;
+                      if (mixer_.setStripInput(stripId, port, channel))
                         pushMixerState();
-                      }
                     });
                     completion(true);
                   })
@@ -416,14 +452,12 @@ MainComponent::MainComponent(const juce::File &configFile)
                     }
 
                     safeCallAsync([this, stripId, desc]() {
-                      if (auto *s = mixer_.getStrip(stripId)) {
-                        s->loadPlugin(desc, mixer_.getFormatManager(),
-                                      [this](bool success) {
-                                        if (success) {
-                                          pushMixerState();
-                                        }
-                                      });
-                      }
+                      mixer_.loadStripPlugin(stripId, desc,
+                                             [this](bool success) {
+                                               if (success) {
+                                                 pushMixerState();
+                                               }
+                                             });
                     });
                     completion(true);
                   })
@@ -443,6 +477,183 @@ MainComponent::MainComponent(const juce::File &configFile)
                     });
                     completion(true);
                   })
+              .withNativeFunction(
+                  "setStripSandboxed",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 2) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String stripId = args[0].toString();
+                    bool sandboxed = (bool)args[1];
+                    safeCallAsync([this, stripId, sandboxed]() {
+                      auto *s = mixer_.getStrip(stripId);
+                      if (s == nullptr || s->sandboxed == sandboxed)
+                        return;
+                      s->sandboxed = sandboxed;
+
+                      // Reload the current plugin in its new home, state
+                      // and all
+                      auto *plugin = s->getPlugin();
+                      juce::PluginDescription desc;
+                      bool found = false;
+                      for (const auto &d :
+                           pluginScanner_.getKnownPluginList().getTypes()) {
+                        if (d.uniqueId == s->pluginUid) {
+                          desc = d;
+                          found = true;
+                          break;
+                        }
+                      }
+                      if (plugin == nullptr || !found) {
+                        pushMixerState();
+                        return;
+                      }
+                      juce::MemoryBlock state;
+                      plugin->getStateInformation(state);
+                      mixer_.loadStripPlugin(
+                          stripId, desc, [this](bool) { pushMixerState(); },
+                          state);
+                    });
+                    completion(true);
+                  })
+              .withNativeFunction(
+                  "addReturnBus",
+                  [this](const juce::Array<juce::var> &,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    safeCallAsync([this]() {
+                      mixer_.addReturnBus();
+                      pushMixerState();
+                    });
+                    completion(true);
+                  })
+              .withNativeFunction(
+                  "removeBus",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 1) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String busId = args[0].toString();
+                    safeCallAsync([this, busId]() {
+                      if (mixer_.removeBus(busId))
+                        pushMixerState();
+                    });
+                    completion(true);
+                  })
+              .withNativeFunction(
+                  "setBusMix",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 3) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String busId = args[0].toString();
+                    float gainDb = (float)args[1];
+                    bool muted = (bool)args[2];
+                    safeCallAsync([this, busId, gainDb, muted]() {
+                      if (mixer_.setBusMix(busId, gainDb, muted))
+                        pushMixerState();
+                    });
+                    completion(true);
+                  })
+              .withNativeFunction(
+                  "setBusOutput",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 2) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String busId = args[0].toString();
+                    juce::String outputBusId = args[1].toString();
+                    safeCallAsync([this, busId, outputBusId]() {
+                      if (mixer_.setBusOutput(busId, outputBusId))
+                        pushMixerState();
+                    });
+                    completion(true);
+                  })
+              .withNativeFunction(
+                  "setBusEffect",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 2) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String busId = args[0].toString();
+                    int pluginUid = (int)args[1];
+
+                    juce::PluginDescription desc;
+                    bool found = false;
+                    for (const auto &d :
+                         pluginScanner_.getKnownPluginList().getTypes()) {
+                      if (d.uniqueId == pluginUid) {
+                        desc = d;
+                        found = true;
+                        break;
+                      }
+                    }
+
+                    safeCallAsync([this, busId, desc, found]() {
+                      auto *bus = mixer_.getBus(busId);
+                      if (bus == nullptr)
+                        return;
+                      if (!found) { // e.g. "None" selected
+                        bus->unloadEffect();
+                        pushMixerState();
+                        return;
+                      }
+                      mixer_.loadBusEffect(busId, desc, [this](bool success) {
+                        if (success)
+                          pushMixerState();
+                      });
+                    });
+                    completion(true);
+                  })
+              .withNativeFunction(
+                  "showBusEditor",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 1) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String busId = args[0].toString();
+                    safeCallAsync([this, busId]() {
+                      if (auto *bus = mixer_.getBus(busId))
+                        bus->showEditor();
+                    });
+                    completion(true);
+                  })
+              .withNativeFunction(
+                  "setStripSend",
+                  [this](const juce::Array<juce::var> &args,
+                         juce::WebBrowserComponent::NativeFunctionCompletion
+                             completion) {
+                    if (args.size() < 3) {
+                      completion(false);
+                      return;
+                    }
+                    juce::String stripId = args[0].toString();
+                    juce::String busId = args[1].toString();
+                    float gainDb = (float)args[2];
+                    safeCallAsync([this, stripId, busId, gainDb]() {
+                      if (mixer_.setStripSend(stripId, busId, gainDb))
+                        pushMixerState();
+                    });
+                    completion(true);
+                  })
               .withNativeFunction(
                   "requestPluginsState",
                   [this](const juce::Array<juce::var> &,
@@ -613,6 +824,7 @@ MainComponent::MainComponent(const juce::File &configFile)
       pushLogMessage("<b>[ExpressionMap]</b> Loaded from " +
                      doricolibFile.getFileName());
       noteTracker.setExpressionMap(&expressionMap);
+      SetScriptExpressionMap(&expressionMap);
     } else {
       pushLogMessage("<b>[ExpressionMap]</b> Failed to parse " +
                          doricolibFile.getFileName(),
@@ -624,7 +836,8 @@ MainComponent::MainComponent(const juce::File &configFile)
                    true);
   }
 
-  auto noteToJson = [](const fiddle::Note &n) {
+  auto noteToJson = [this](const TrackedNote &tracked) {
+    auto n = NoteStreamTracker::toProto(tracked, &expressionMap);
     juce::DynamicObject::Ptr obj = new juce::DynamicObject();
     obj->setProperty("id", (juce::int64)n.id());
     obj->setProperty("noteNumber", (int)n.note_number());
@@ -634,17 +847,11 @@ MainComponent::MainComponent(const juce::File &configFile)
     obj->setProperty("startSample", (juce::int64)n.start_sample());
     obj->setProperty("durationSamples", (juce::int64)n.duration_samples());
 
-    // Compute end velocity for UI display:
-    // VELOCITY mode (short notes) → same as start velocity
-    // CC mode (sustained notes) → last CC1 value from automation
-    int endVel = (int)n.start_velocity();
-    if (n.dynamics_mode() == fiddle::Note::CC) {
-      auto it = n.cc_automation().find(1); // CC1
-      if (it != n.cc_automation().end() && it->second.points_size() > 0) {
-        endVel = (int)it->second.points(it->second.points_size() - 1).value();
-      }
-    }
-    obj->setProperty("endVelocity", endVel);
+    // End velocity for UI display: the start velocity for VELOCITY mode
+    // (short notes), the last CC1 value for CC mode (sustained notes)
+    obj->setProperty("endVelocity", (int)tracked.endVelocity);
+    obj->setProperty("transitionIn", transitionName(tracked.transitionIn));
+    obj->setProperty("transitionOut", transitionName(tracked.transitionOut));
 
     juce::DynamicObject::Ptr dims = new juce::DynamicObject();
     for (auto const &it : n.notation_dimensions()) {
@@ -698,94 +905,84 @@ MainComponent::MainComponent(const juce::File &configFile)
     return juce::JSON::toString(juce::var(obj.get()));
   };
 
-  noteTracker.uiLogger = [this](const juce::String &msg) {
-    pushLogMessage(msg);
-  };
-
-  noteTracker.setCallbacks(
-      {[this, noteToJson](const fiddle::Note &n) {
-         pushLogMessage(
-             "<b>[Tracker]</b> Note ON: " + juce::String((juce::int64)n.id()) +
-             " (Ch " + juce::String((int)n.channel()) + ")");
-         subnoteGenerator.onNoteStarted(n);
-         scriptEngine->execute("void processNote(Note@)", (void *)&n);
-
-         double triggerTimeMs = juce::Time::getMillisecondCounterHiRes() +
-                                mixer_.getPlaybackDelayMs();
-         // JUCE MidiMessage takes channels 1-16 to build valid MIDI byte
-         // payload
-         juce::MidiMessage msg = juce::MidiMessage::noteOn(
-             (int)n.channel() + 1, (int)n.note_number(),
-             (juce::uint8)n.start_velocity());
-         // Route the message to the MixerModel.
-         // n.channel() from Dorico protobuf is 1-16, but Mixer model tracks
-         // uses 0-15.
-         std::cerr << "[MainComponent] Routing Note ON (port " << n.port()
-                   << ", ch " << n.channel() << ")" << std::endl;
-         mixer_.routeNoteEvent((int)n.port(), (int)n.channel() - 1, msg,
-                               triggerTimeMs);
-
-         juce::String json = noteToJson(n);
-         juce::String call = juce::String::formatted(
-             "updateNoteState(%s, 'started')", json.toRawUTF8());
-         std::cerr << "[MainComponent] Call: " << call << std::endl;
-         safeCallAsync(
-             [this, call]() { webComponent.evaluateJavascript(call); });
-       },
-       [this, noteToJson](const fiddle::Note &n) {
-         pushLogMessage("<b>[Tracker]</b> Note OFF: " +
-                        juce::String((juce::int64)n.id()));
-         subnoteGenerator.onNoteEnded(n);
-
-         double triggerTimeMs = juce::Time::getMillisecondCounterHiRes() +
-                                mixer_.getPlaybackDelayMs();
-         // JUCE MidiMessage takes channels 1-16 to build valid MIDI byte
-         // payload
-         juce::MidiMessage msg = juce::MidiMessage::noteOff(
-             (int)n.channel() + 1, (int)n.note_number(), (juce::uint8)0);
-
-         std::cerr << "[MainComponent] Routing Note OFF (port " << n.port()
-                   << ", ch " << n.channel() << ")" << std::endl;
-         mixer_.routeNoteEvent((int)n.port(), (int)n.channel() - 1, msg,
-                               triggerTimeMs);
-
-         juce::String json = noteToJson(n);
-         juce::String call = juce::String::formatted(
-             "updateNoteState(%s, 'ended')", json.toRawUTF8());
-         std::cerr << "[MainComponent] Call: " << call << std::endl;
-         safeCallAsync(
-             [this, call]() { webComponent.evaluateJavascript(call); });
-       },
-       [this, noteToJson](const fiddle::Note &n) {
-         juce::String json = noteToJson(n);
-         juce::String call = juce::String::formatted(
-             "updateNoteState(%s, 'updated')", json.toRawUTF8());
-         safeCallAsync(
-             [this, call]() { webComponent.evaluateJavascript(call); });
-       },
-       [this, midiEventToJson](const fiddle::MidiEvent &event,
-                               uint64_t absoluteSamples, int oldCCVal) {
-         juce::String json = midiEventToJson(event, absoluteSamples, oldCCVal);
-         juce::String call =
-             juce::String::formatted("pushMidiEvent(%s)", json.toRawUTF8());
-         safeCallAsync(
-             [this, call]() { webComponent.evaluateJavascript(call); });
-       }});
+  // Everything the tracker reports is acted on here, on the dispatcher
+  // thread, so scripts, routing and the UI never hold up tracking. Events
+  // are held for most of the playback delay first (the lookahead), so by
+  // the time a note is handled the notes that follow it are known.
+  SetScriptLookahead(&lookahead_);
+  trackerEvents_ = std::make_unique<TrackerEventDispatcher>(
+      noteTracker.getEvents(),
+      [this, noteToJson, midiEventToJson](const TrackerEvent &e) {
+        switch (e.type) {
+        case TrackerEvent::Type::NoteStarted: {
+          lookahead_.retireBefore(e.note);
+          const auto &n = phraseNote(e.note);
+          handleNoteStarted(e, n, noteToJson(n));
+          break;
+        }
+        case TrackerEvent::Type::NoteEnded: {
+          const auto &n = phraseNote(e.note);
+          handleNoteEnded(e, n, noteToJson(n));
+          break;
+        }
+        case TrackerEvent::Type::NoteUpdated: {
+          juce::String call = juce::String::formatted(
+              "updateNoteState(%s, 'updated')",
+              noteToJson(e.note).toRawUTF8());
+          safeCallAsync(
+              [this, call]() { webComponent.evaluateJavascript(call); });
+          break;
+        }
+        case TrackerEvent::Type::Midi: {
+          if (!handleTrackedMidi(e))
+            break;
+          juce::String json =
+              midiEventToJson(e.midi, e.absoluteSamples, e.oldCCValue);
+          juce::String call =
+              juce::String::formatted("pushMidiEvent(%s)", json.toRawUTF8());
+          safeCallAsync(
+              [this, call]() { webComponent.evaluateJavascript(call); });
+          break;
+        }
+        }
+      },
+      [this](const TrackerEvent &e) {
+        switch (e.type) {
+        case TrackerEvent::Type::NoteStarted:
+          lookahead_.noteStarted(e.note);
+          phraseAnalyzer_.noteStarted(lookahead_, e.note);
+          break;
+        case TrackerEvent::Type::NoteEnded:
+        case TrackerEvent::Type::NoteUpdated:
+          lookahead_.noteChanged(e.note);
+          break;
+        case TrackerEvent::Type::Midi:
+          if (e.midi.has_transport() &&
+              e.midi.transport().type() !=
+                  fiddle::MidiEvent_TransportEvent_Type_PROGRESS)
+            lookahead_.clear(); // A new phrase, from a new position
+          break;
+        }
+      },
+      [this] { return lookaheadHoldMs(); });
 
   subnoteGenerator.setCallbacks(
-      {[this](const fiddle::Subnote &s) {
-         // Call into script
-         scriptEngine->execute("void processSubnote(Subnote@)", (void *)&s);
-
-         pushSubnoteToWebView(s);
-         safeCallAsync([this, id = s.id()]() {
-           webComponent.evaluateJavascript(juce::String::formatted(
-               "updateNoteState({id: %llu}, 'subnote')", id));
-         });
+      {[this](const std::vector<fiddle::Subnote> &batch) {
+         // Call into script: once per batch, unless the script only has
+         // the per-subnote entry point
+         if (scriptEngine->hasFunction("void processSubnotes(SubnoteBatch@)"))
+           scriptEngine->execute("void processSubnotes(SubnoteBatch@)",
+                                 (void *)&batch);
+         else
+           for (const auto &s : batch)
+             scriptEngine->execute("void processSubnote(Subnote@)",
+                                   (void *)&s);
+
+         pushSubnotesToWebView(batch);
        },
-       [this, noteToJson](const fiddle::Note &n) {
+       [this, noteToJson](const TrackedNote &n) {
          pushLogMessage("<b>[Watchdog]</b> Note Timed Out: " +
-                        juce::String((juce::int64)n.id()));
+                        juce::String((juce::int64)n.id));
          juce::String json = noteToJson(n);
          juce::String call = juce::String::formatted(
              "updateNoteState(%s, 'ended')", json.toRawUTF8());
@@ -795,11 +992,68 @@ MainComponent::MainComponent(const juce::File &configFile)
 
   server = std::make_unique<fiddle::MidiTcpServer>();
   server->onMessageReceived([this](const fiddle::MidiEvent &event) {
+    // Offline export: one of these per host block, so keep it off the log.
+    // It goes through the tracker, behind the notes it vouches for, so the
+    // renderer only moves on once they have been routed.
+    if (event.has_transport() &&
+        event.transport().type() ==
+            fiddle::MidiEvent_TransportEvent_Type_PROGRESS) {
+      noteTracker.processEvent(event);
+      return;
+    }
+
     // Force a log to the UI so we can see the flow
     pushLogMessage("<b>[Server]</b> Received Event Case: " +
                    juce::String((int)event.event_case()) +
                    " Ch: " + juce::String(event.channel()));
 
+    // Each start/locate begins a new render-cache take; audio for the
+    // position is rendered once the playback delay has elapsed.
+    if (event.has_transport()) {
+      if (event.transport().type() ==
+          fiddle::MidiEvent_TransportEvent_Type_STOP) {
+        offlineRenderer_.end();
+        renderCache_.endTake();
+        pushLogMessage("<b>[RenderCache]</b> " +
+                       juce::String((juce::int64)renderCache_.getHitCount()) +
+                       " blocks served, " +
+                       juce::String((juce::int64)renderCache_.getMissCount()) +
+                       " rendered");
+        // Each batch costs one script call and one UI update, so this is
+        // the cross-thread traffic saved over one per subnote. The time
+        // spent delivering them gives the capacity, for comparing builds.
+        const auto subnotes = subnoteGenerator.getSubnoteCount();
+        const double seconds = subnoteGenerator.getDeliverySeconds();
+        pushLogMessage(
+            "<b>[Subnotes]</b> " + juce::String((juce::int64)subnotes) +
+            " delivered in " +
+            juce::String((juce::int64)subnoteGenerator.getBatchCount()) +
+            " batches" +
+            (subnotes > 0 && seconds > 0.0
+                 ? ", " + juce::String(seconds * 1.0e6 / (double)subnotes, 1) +
+                       " us each (capacity " +
+                       juce::String((juce::int64)((double)subnotes / seconds)) +
+                       " subnotes/s)"
+                 : juce::String()));
+      } else {
+        uint64_t pos = event.transport().has_host_sample_position()
+                           ? event.transport().host_sample_position()
+                           : event.host_sample_position();
+        int delayMs = mixer_.getPlaybackDelayMs();
+        renderCache_.beginTake(
+            pos, juce::Time::getMillisecondCounterHiRes() + delayMs, delayMs);
+
+        if (event.transport().type() ==
+                fiddle::MidiEvent_TransportEvent_Type_START &&
+            event.transport().offline()) {
+          offlineRenderer_.begin(pos, event.transport().latency_samples());
+          pushLogMessage("<b>[Transport]</b> Offline export: rendering "
+                         "faster than real time");
+        }
+      }
+    }
+    renderCache_.addEvent(event);
+
     noteTracker.processEvent(event);
     pushEventToWebView(event);
 
@@ -949,6 +1203,7 @@ MainComponent::MainComponent(const juce::File &configFile)
     });
   });
 
+  trackerEvents_->start();
   server->startThread();
 
   startTimer(20); // 20ms tick for subnotes
@@ -966,10 +1221,22 @@ MainComponent::MainComponent(const juce::File &configFile)
   // Establish initial config file location
   currentConfigFile = configFile;
 
+  // Report background plugin loading to the UI; strips go live one by one
+  mixer_.getLoadQueue().onProgress = [this](int done, int total,
+                                            const juce::String &name) {
+    webComponent.evaluateJavascript(
+        "setLoadProgress(" + juce::String(done) + "," + juce::String(total) +
+        ",'" + escapeForJS(name) + "')");
+    pushMixerState();
+    if (done == total)
+      pushLogMessage("<b>[Mixer]</b> Loaded " + juce::String(total) +
+                     " plugins");
+  };
+
   // Defer config restore to after the constructor returns.
-  // loadPlugin() uses createPluginInstanceAsync() which requires the message
-  // loop to be running — calling it from the constructor deadlocks because
-  // we're on the message thread and the loop hasn't started yet.
+  // loadStripPlugin() uses createPluginInstanceAsync() which requires the
+  // message loop to be running — calling it from the constructor deadlocks
+  // because we're on the message thread and the loop hasn't started yet.
   safeCallAsync([this]() {
     std::vector<juce::String> configLogs =
         FiddleConfig::load(pluginScanner_, mixer_, currentConfigFile);
@@ -1044,6 +1311,92 @@ MainComponent::~MainComponent() {
   stopTimer();
   deviceManager.removeAudioCallback(this);
   server.reset();
+  trackerEvents_->stop();
+}
+
+const TrackedNote &MainComponent::phraseNote(const TrackedNote &n) {
+  const auto *held = lookahead_.find(n);
+  return held != nullptr ? *held : n;
+}
+
+void MainComponent::handleNoteStarted(const TrackerEvent &e,
+                                      const TrackedNote &n,
+                                      const juce::String &json) {
+  pushLogMessage("<b>[Tracker]</b> Note ON: " +
+                 juce::String((juce::int64)n.id) + " (Ch " +
+                 juce::String((int)n.channel) + ")");
+  subnoteGenerator.onNoteStarted(n);
+  scriptEngine->execute("void processNote(Note@)", (void *)&n);
+
+  double triggerTimeMs = triggerTimeFor(n.startSample, e.arrivalMs);
+  juce::MidiMessage msg = juce::MidiMessage::noteOn(
+      midiChannelFor(n.channel), (int)n.noteNumber,
+      (juce::uint8)n.startVelocity);
+  // Route the message to the MixerModel.
+  // n.channel is 1-16 as in Dorico's protobuf, but Mixer model tracks
+  // use 0-15.
+  mixer_.routeEvent((int)n.port, (int)n.channel - 1, msg, triggerTimeMs);
+
+  juce::String call = juce::String::formatted(
+      "updateNoteState(%s, 'started')", json.toRawUTF8());
+  safeCallAsync([this, call]() { webComponent.evaluateJavascript(call); });
+}
+
+void MainComponent::handleNoteEnded(const TrackerEvent &e,
+                                    const TrackedNote &n,
+                                    const juce::String &json) {
+  pushLogMessage("<b>[Tracker]</b> Note OFF: " +
+                 juce::String((juce::int64)n.id));
+  subnoteGenerator.onNoteEnded(n);
+
+  double triggerTimeMs =
+      triggerTimeFor(n.startSample + n.durationSamples, e.arrivalMs);
+  juce::MidiMessage msg = juce::MidiMessage::noteOff(
+      midiChannelFor(n.channel), (int)n.noteNumber, (juce::uint8)0);
+  mixer_.routeEvent((int)n.port, (int)n.channel - 1, msg, triggerTimeMs);
+
+  juce::String call = juce::String::formatted(
+      "updateNoteState(%s, 'ended')", json.toRawUTF8());
+  safeCallAsync([this, call]() { webComponent.evaluateJavascript(call); });
+}
+
+bool MainComponent::handleTrackedMidi(const TrackerEvent &e) {
+  const auto &event = e.midi;
+  // Controllers, pitch bend and pressure play on the same delayed,
+  // sample-accurate timeline as the notes of their channel
+  if (auto msg = controllerMessageFor(event))
+    mixer_.routeEvent((int)event.port(), (int)event.channel() - 1, *msg,
+                      triggerTimeFor(e.absoluteSamples, e.arrivalMs));
+
+  if (!event.has_transport())
+    return true;
+  switch (event.transport().type()) {
+  case fiddle::MidiEvent_TransportEvent_Type_PROGRESS:
+    offlineRenderer_.progress(event.transport().host_sample_position());
+    return false;
+  case fiddle::MidiEvent_TransportEvent_Type_START:
+    pushLogMessage("<b>[Tracker]</b> Session reset via Transport Start");
+    break;
+  case fiddle::MidiEvent_TransportEvent_Type_STOP:
+  case fiddle::MidiEvent_TransportEvent_Type_LOCATE: {
+    // Throw away everything already rendered or scheduled so the host goes
+    // silent within a block or two instead of playing out the full delay.
+    // Done here, in order with the routing above, so that nothing the
+    // tracker reported before the stop is scheduled after the flush.
+    mixer_.flush();
+    audioSharedMemory_.flush();
+    subnoteGenerator.clear();
+    bool isStop =
+        event.transport().type() == fiddle::MidiEvent_TransportEvent_Type_STOP;
+    pushLogMessage(juce::String("<b>[Transport]</b> ") +
+                   (isStop ? "Stop" : "Locate") +
+                   ": flushed audio ring and pending MIDI");
+    break;
+  }
+  default:
+    break;
+  }
+  return true;
 }
 
 void MainComponent::setupWebView() {
@@ -1087,9 +1440,15 @@ void MainComponent::setupWebView() {
 }
 
 void MainComponent::pushMixerState() {
+  // Every mixer edit ends up here: keep the per-input subnote policies in
+  // step with strip inputs and families
+  subnoteGenerator.setPolicies(mixer_.resolveSubnotePolicies());
+
   juce::String json = mixer_.toJson();
   juce::String call = "setMixerState('" + escapeForJS(json) + "')";
   webComponent.evaluateJavascript(call);
+  webComponent.evaluateJavascript("setMixerBuses('" +
+                                  escapeForJS(mixer_.busesToJson()) + "')");
 }
 
 void MainComponent::pushLogMessage(const juce::String &msg, bool isError) {
@@ -1186,20 +1545,44 @@ void MainComponent::pushEventToWebView(const fiddle::MidiEvent &event) {
                      .replace(" ", "&nbsp;"));
 }
 
-void MainComponent::pushSubnoteToWebView(const fiddle::Subnote &subnote) {
-  juce::String msg = juce::String::formatted(
-      "<b>[Subnote]</b> Note: %d ID: %llu Offset: %llu %s",
-      subnote.note_number(), subnote.id(), subnote.offset_samples(),
-      subnote.is_last() ? "(Final)" : "");
+void MainComponent::pushSubnotesToWebView(
+    const std::vector<fiddle::Subnote> &batch) {
+  // One log entry and one note-state update for the whole batch
+  juce::StringArray lines;
+  juce::String ids;
+  for (const auto &subnote : batch) {
+    lines.add(juce::String::formatted(
+        "<b>[Subnote]</b> Note: %d ID: %llu Offset: %llu %s",
+        subnote.note_number(), subnote.id(), subnote.offset_samples(),
+        subnote.is_last() ? "(Final)" : ""));
+    ids << (ids.isEmpty() ? "" : ",") << (juce::int64)subnote.id();
+  }
+  pushLogMessage(lines.joinIntoString("<br>"));
 
-  pushLogMessage(msg);
+  safeCallAsync([this, call = "updateSubnotes([" + ids + "])"]() {
+    webComponent.evaluateJavascript(call);
+  });
 }
 
 void MainComponent::timerCallback() {
-  subnoteGenerator.tick(noteTracker.getSessionSamples());
+  // The clock is interpolated from the host position, so a late timer
+  // fire only delays subnotes; it never shifts them. Notes reach the
+  // generator one lookahead hold after the tracker saw them, so its time
+  // runs the same hold behind, or every boundary within the hold would
+  // fire on the note's first tick.
+  const auto &clock = noteTracker.getClock();
+  const uint64_t now = clock.now();
+  const uint64_t held = clock.samplesFor(lookaheadHoldMs() / 1000.0);
+  subnoteGenerator.tick(now > held ? now - held : 0);
 
   static int hbCounter = 0;
-  if (++hbCounter % 50 == 0) { // Every 1 second (20ms * 50)
+  if (++hbCounter % 25 == 0) { // Per-strip DSP load and sleep, every 500 ms
+    juce::String call =
+        "setStripLoads('" + escapeForJS(mixer_.loadsToJson()) + "', '" +
+        escapeForJS(mixer_.sleepingToJson()) + "')";
+    safeCallAsync([this, call]() { webComponent.evaluateJavascript(call); });
+  }
+  if (hbCounter % 50 == 0) { // Every 1 second (20ms * 50)
     safeCallAsync([this, val = hbCounter / 50]() {
       webComponent.evaluateJavascript("setHeartbeat(" + juce::String(val) +
                                       ")");
@@ -1214,12 +1597,59 @@ void MainComponent::paint(juce::Graphics &g) {
 
 void MainComponent::resized() { webComponent.setBounds(getLocalBounds()); }
 
+int MainComponent::midiChannelFor(uint32_t protoChannel) {
+  // Protobuf channels are 1-16, as JUCE expects
+  return juce::jlimit(1, 16, (int)protoChannel);
+}
+
+std::optional<juce::MidiMessage>
+MainComponent::controllerMessageFor(const fiddle::MidiEvent &event) {
+  const int ch = midiChannelFor(event.channel());
+  if (event.has_cc())
+    return juce::MidiMessage::controllerEvent(
+        ch, (int)event.cc().controller_number() & 0x7f,
+        (int)event.cc().controller_value() & 0x7f);
+  if (event.has_pitch_bend())
+    return juce::MidiMessage::pitchWheel(
+        ch, (int)juce::jmin(event.pitch_bend().value(), 0x3fffu));
+  if (event.has_channel_pressure())
+    return juce::MidiMessage::channelPressureChange(
+        ch, (int)event.channel_pressure().value() & 0x7f);
+  if (event.has_aftertouch())
+    return juce::MidiMessage::aftertouchChange(
+        ch, (int)event.aftertouch().note_number() & 0x7f,
+        (int)event.aftertouch().value() & 0x7f);
+  return std::nullopt;
+}
+
+double MainComponent::lookaheadHoldMs() const {
+  // Offline export has no clock to run ahead of: handle at once
+  if (offlineRenderer_.isActive())
+    return 0.0;
+  return (double)juce::jmax(0, mixer_.getPlaybackDelayMs() -
+                                   kLookaheadHeadroomMs);
+}
+
+double MainComponent::triggerTimeFor(uint64_t hostSamples,
+                                     double arrivalMs) const {
+  // Offline export renders by host position; real time renders by the
+  // clock, one playback delay after the event arrived (however long the
+  // lookahead held it).
+  if (offlineRenderer_.isActive())
+    return (double)hostSamples;
+  return arrivalMs + mixer_.getPlaybackDelayMs();
+}
+
 void MainComponent::audioDeviceAboutToStart(juce::AudioIODevice *device) {
   // Pass the actual device sample rate and block size down to the mixer and
   // plugins
   if (device) {
-    mixer_.prepareToPlay(device->getCurrentSampleRate(),
-                         device->getCurrentBufferSizeSamples());
+    auto config = RenderConfig::fromDevice(*device);
+    mixer_.prepareToPlay(config);
+    pluginHost_.setRenderConfig(config);
+    renderCache_.prepare(config.sampleRate);
+    noteTracker.getClock().setSampleRate(config.sampleRate);
+    subnoteGenerator.setSampleRate(config.sampleRate);
   }
 }
 
@@ -1242,12 +1672,26 @@ void MainComponent::audioDeviceIOCallbackWithContext(
     }
   }
 
+  // During an offline export the render thread owns the mixer and the ring
+  if (offlineRenderer_.isActive()) {
+    offlineRenderer_.yieldFromAudioThread();
+    return;
+  }
+
   juce::AudioBuffer<float> audioBuffer(outputChannelData, numOutputChannels,
                                        numSamples);
   double currentTime = juce::Time::getMillisecondCounterHiRes();
-
-  // 1. Process VST instruments and mix down to audioBuffer
-  mixer_.processBlock(audioBuffer, currentTime);
+  double msPerSample = 1000.0 / mixer_.getSampleRate();
+
+  // 1. Process VST instruments and mix down to audioBuffer, or replay the
+  // block from the render cache when this take matches an earlier one.
+  bool fromCache = renderCache_.process(
+      audioBuffer, currentTime, mixer_.getMixGeneration(),
+      [&](juce::AudioBuffer<float> &buffer) {
+        mixer_.processBlock(buffer, currentTime, msPerSample);
+      });
+  if (fromCache)
+    mixer_.skipBlock(numSamples, currentTime, msPerSample);
 
   // 2. Transmit the mixed audioBuffer to Dorico via Shared Memory IPC
   audioSharedMemory_.pushAudio(audioBuffer);
@@ -3,12 +3,16 @@
 #include "../AudioSharedMemory.h"
 #include "DoricoInstrumentBrowser.h"
 #include "InstrumentMapper.h"
+#include "LookaheadBuffer.h"
 #include "MasterInstrumentList.h"
 #include "MidiTcpServer.h"
 #include "MixerModel.h"
 #include "NoteStreamTracker.h"
+#include "OfflineRenderer.h"
+#include "PhraseAnalyzer.h"
 #include "PluginHost.h"
 #include "PluginScanner.h"
+#include "RenderCache.h"
 #include "ScriptEngine.h"
 #include "SubnoteGenerator.h"
 #include "midi_event.pb.h"
@@ -69,6 +73,14 @@ private:
   MixerModel mixer_;
   std::unique_ptr<ScriptEngine> scriptEngine;
   AudioSharedMemory audioSharedMemory_{true}; // True = Producer
+  RenderCache renderCache_;
+  OfflineRenderer offlineRenderer_{mixer_, audioSharedMemory_};
+  LookaheadBuffer lookahead_{noteTracker.getClock()}; // dispatcher thread
+  PhraseAnalyzer phraseAnalyzer_{noteTracker.getClock()};
+  std::unique_ptr<TrackerEventDispatcher> trackerEvents_;
+
+  // What the lookahead leaves of the playback delay for handling and routing
+  static constexpr int kLookaheadHeadroomMs = 100;
 
   uint64_t lastSampleTime = 0;
   uint32_t lastSystemTime = 0;
@@ -79,10 +91,25 @@ private:
   void setupWebView();
   void pushLogMessage(const juce::String &msg, bool isError = false);
   void pushMixerState();
+  double triggerTimeFor(uint64_t hostSamples, double arrivalMs) const;
+  double lookaheadHoldMs() const;
+  static int midiChannelFor(uint32_t protoChannel);
+  static std::optional<juce::MidiMessage>
+  controllerMessageFor(const fiddle::MidiEvent &event);
   static juce::String escapeForJS(const juce::String &str);
 
+  // Tracker events, on the dispatcher thread
+  /// `n` with its phrase context, from the lookahead when it is held there.
+  const TrackedNote &phraseNote(const TrackedNote &n);
+  void handleNoteStarted(const TrackerEvent &e, const TrackedNote &n,
+                         const juce::String &json);
+  void handleNoteEnded(const TrackerEvent &e, const TrackedNote &n,
+                       const juce::String &json);
+  /// False for events the UI doesn't see.
+  bool handleTrackedMidi(const TrackerEvent &e);
+
   void pushEventToWebView(const fiddle::MidiEvent &event);
-  void pushSubnoteToWebView(const fiddle::Subnote &subnote);
+  void pushSubnotesToWebView(const std::vector<fiddle::Subnote> &batch);
   void loadConfigFromFile(const juce::File &file);
   std::optional<juce::WebBrowserComponent::Resource>
   getResource(const juce::String &url);
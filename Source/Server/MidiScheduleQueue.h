@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+#include <vector>
+
+namespace fiddle {
+
+/// A short (1-3 byte) MIDI message stamped with its trigger time. Plain
+/// 16-byte data, so queuing one never allocates and a dense CC ramp is a
+/// contiguous run of small records rather than per-note protobuf maps.
+struct ScheduledMidi {
+  double time = 0.0;
+  uint32_t seq = 0; // arrival order; breaks ties between equal times
+  juce::uint8 data[3] = {0, 0, 0};
+  juce::uint8 size = 0; // 0 = flush marker
+
+  juce::MidiMessage toMidiMessage() const {
+    return juce::MidiMessage(data, (int)size);
+  }
+};
+static_assert(sizeof(ScheduledMidi) == 16, "keep queue records compact");
+
+/**
+ * Time-ordered MIDI queue between one producer (the TrackerEvents
+ * dispatcher thread, which routes tracked MIDI) and one consumer (whichever
+ * thread renders the strip).
+ *
+ * The producer writes into a lock-free SPSC ring. Each block the consumer
+ * drains the ring into a min-heap it owns, ordered by trigger time and then
+ * arrival order, so a note-off and a note-on for the same key at the same
+ * time keep their order. Notes, controllers, pitch bend and pressure share
+ * the one queue, so a strip sees a single merged timeline. Insertion is
+ * O(log n); a block pops only the k events due in it, in time order, at
+ * O(log n) each, instead of scanning every pending event.
+ *
+ * Both buffers are allocated up front. When either is full the event is
+ * dropped and counted rather than allocating on the audio thread.
+ */
+class MidiScheduleQueue {
+public:
+  static constexpr int kDefaultFifoSize = 4096;
+  static constexpr int kDefaultMaxPending = 1 << 15;
+
+  explicit MidiScheduleQueue(int fifoSize = kDefaultFifoSize,
+                             int maxPending = kDefaultMaxPending)
+      : fifo_(fifoSize) {
+    fifoData_.resize((size_t)fifoSize);
+    heap_.reserve((size_t)maxPending);
+  }
+
+  // ── Producer ──
+
+  /// Queue `msg` to fire at `time`. Returns false (and drops it) if the
+  /// message isn't a short message or the ring is full.
+  bool push(double time, const juce::MidiMessage &msg) {
+    const int size = msg.getRawDataSize();
+    if (size < 1 || size > 3 || msg.isSysEx())
+      return false;
+    ScheduledMidi item;
+    item.time = time;
+    item.size = (juce::uint8)size;
+    std::copy_n(msg.getRawData(), size, item.data);
+    if (pushItem(item))
+      return true;
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  /// Ask the consumer to drop everything queued before this call. Travels
+  /// in-band, so events pushed afterwards survive.
+  void pushFlush() {
+    if (!pushItem(ScheduledMidi{}))
+      flushOverflow_.store(true, std::memory_order_release);
+  }
+
+  // ── Consumer ──
+
+  /// Move newly arrived events into the heap. Returns true if a flush was
+  /// requested, in which case everything queued before it is gone.
+  bool drain() {
+    bool flushed = flushOverflow_.exchange(false, std::memory_order_acq_rel);
+    if (flushed)
+      heap_.clear();
+
+    int start1, size1, start2, size2;
+    fifo_.prepareToRead(fifo_.getNumReady(), start1, size1, start2, size2);
+    auto take = [&](int start, int size) {
+      for (int i = start; i < start + size; ++i) {
+        auto item = fifoData_[(size_t)i];
+        if (item.size == 0) {
+          heap_.clear();
+          flushed = true;
+        } else if (heap_.size() < heap_.capacity()) {
+          item.seq = nextSeq_++;
+          heap_.push_back(item);
+          std::push_heap(heap_.begin(), heap_.end(), Later{});
+        } else {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    };
+    take(start1, size1);
+    take(start2, size2);
+    fifo_.finishedRead(size1 + size2);
+    return flushed;
+  }
+
+  /// Pop every event due before `endTime`, earliest first, calling fn(item).
+  template <typename Fn> void popDue(double endTime, Fn &&fn) {
+    while (!heap_.empty() && heap_.front().time < endTime) {
+      std::pop_heap(heap_.begin(), heap_.end(), Later{});
+      fn(heap_.back());
+      heap_.pop_back();
+    }
+  }
+
+  /// Whether any event is due before `endTime`.
+  bool hasDue(double endTime) const {
+    return !heap_.empty() && heap_.front().time < endTime;
+  }
+
+  /// Drop everything pending (consumer side).
+  void clear() { heap_.clear(); }
+
+  size_t getNumPending() const { return heap_.size(); }
+
+  /// Events lost to a full ring or heap since construction.
+  uint64_t getNumDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  /// Heap order: the root is the earliest time, then the earliest arrival.
+  struct Later {
+    bool operator()(const ScheduledMidi &a, const ScheduledMidi &b) const {
+      // Wrap-safe: pending events are never 2^31 arrivals apart
+      return a.time != b.time ? a.time > b.time
+                              : (int32_t)(a.seq - b.seq) > 0;
+    }
+  };
+
+  bool pushItem(const ScheduledMidi &item) {
+    int start1, size1, start2, size2;
+    fifo_.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 == 0)
+      return false;
+    fifoData_[(size_t)start1] = item;
+    fifo_.finishedWrite(1);
+    return true;
+  }
+
+  // Producer -> consumer
+  juce::AbstractFifo fifo_;
+  std::vector<ScheduledMidi> fifoData_;
+  std::atomic<bool> flushOverflow_{false};
+  std::atomic<uint64_t> dropped_{0};
+
+  // Consumer only
+  std::vector<ScheduledMidi> heap_;
+  uint32_t nextSeq_ = 0;
+};
+
+} // namespace fiddle
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+namespace fiddle {
+
+/**
+ * Counts changes to how the mixer sounds: anything that would make the same
+ * MIDI render differently. Strip and bus edits, plugin loads and unloads,
+ * plugin parameter and state changes, and re-preparing for a new sample
+ * rate all bump it. RenderCache folds it into every chunk key, so audio is
+ * only replayed against the mix that rendered it.
+ *
+ * Listens to loaded plugins for parameter and state changes made from
+ * their editors or by automation; those callbacks may come from any thread,
+ * so a bump is a single relaxed increment.
+ */
+class MixGeneration : public juce::AudioProcessorListener {
+public:
+  void bump() { value_.fetch_add(1, std::memory_order_relaxed); }
+  uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+  void audioProcessorParameterChanged(juce::AudioProcessor *, int,
+                                      float) override {
+    bump();
+  }
+  void audioProcessorChanged(juce::AudioProcessor *,
+                             const ChangeDetails &) override {
+    bump();
+  }
+
+private:
+  std::atomic<uint64_t> value_{0};
+};
+
+} // namespace fiddle
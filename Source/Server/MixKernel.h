@@ -0,0 +1,23 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace fiddle {
+
+/// dest += src * gain, the gain ramping linearly from `from` to `to` across
+/// the block. This is the mixer's summing primitive: strips, sends and buses
+/// all reach their destination through it, touching each sample once.
+inline void mixWithGainRamp(float *dest, const float *src, int numSamples,
+                            float from, float to) {
+  if (from == to) {
+    if (to != 0.0f)
+      juce::FloatVectorOperations::addWithMultiply(dest, src, to, numSamples);
+    return;
+  }
+  // Simple induction over i, so the compiler vectorises it too
+  const float step = (to - from) / (float)juce::jmax(1, numSamples);
+  for (int i = 0; i < numSamples; ++i)
+    dest[i] += src[i] * (from + step * (float)i);
+}
+
+} // namespace fiddle
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "MixGeneration.h"
+#include "MixKernel.h"
+#include "PluginEditorWindow.h"
+#include "RcuDomain.h"
+#include "RenderConfig.h"
+#include <atomic>
+#include <iostream>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+namespace fiddle {
+
+/// A stereo submix in the mixer graph. Family buses are created from the
+/// strips' `family` (one per section, e.g. all Strings) and carry the strips
+/// routed to them; return buses are fed by strip sends and host one effect
+/// plugin, so a reverb runs once per bus instead of once per instrument.
+/// Each bus sums into its output bus (or the master when none).
+struct MixerBus {
+  enum class Kind { Family, Return };
+
+  static constexpr int kNumChannels = 2;
+
+  juce::String id;
+  juce::String name;
+  Kind kind = Kind::Family;
+  juce::String family;      // Family buses: the strip family they collect
+  juce::String outputBusId; // empty = master
+
+  std::atomic<float> gainDb{0.0f};
+  std::atomic<bool> muted{false};
+
+  /// Cut the effect's tail at the next block (transport stop/locate).
+  std::atomic<bool> resetPending{false};
+
+  // Effect (return buses)
+  int effectUid = 0;
+  // The latest load MixerModel::loadBusEffect() started (0 = none)
+  uint64_t loadTicket = 0;
+  std::unique_ptr<PluginEditorWindow> editorWindow;
+
+  /// Set by MixerModel. Effect swaps wait on it before freeing the old one.
+  RcuDomain *rcu = nullptr;
+
+  /// Set by MixerModel. Bumped on effect swaps; listens to the effect for
+  /// edits to its settings.
+  MixGeneration *mixGeneration = nullptr;
+
+  /// What the bus was last prepared for; buffers hold config.maxBlockSize.
+  RenderConfig config;
+
+  // Render thread only. `buffer` collects this block's input; render cost is
+  // tracked like a strip's so effect buses can be scheduled by cost.
+  juce::AudioBuffer<float> buffer;
+  float renderCostMs = 0.0f;
+
+  ~MixerBus() {
+    editorWindow.reset(); // before the plugin it edits
+    delete effect.load(std::memory_order_relaxed);
+  }
+
+  juce::AudioPluginInstance *getEffect() const {
+    auto *slot = effect.load(std::memory_order_acquire);
+    return slot ? slot->instance.get() : nullptr;
+  }
+
+  /// Only while nothing renders (device stopped, or not yet published).
+  void prepareToPlay(const RenderConfig &newConfig) {
+    config = newConfig;
+    buffer.setSize(kNumChannels, config.maxBlockSize);
+    if (auto *slot = effect.load(std::memory_order_acquire)) {
+      prepareInstance(*slot->instance, config);
+      slot->buffer.setSize(numChannelsFor(*slot->instance),
+                           config.maxBlockSize);
+    }
+  }
+
+  /// Start a block: clear the input sums.
+  void beginBlock(int numSamples) {
+    buffer.clear(0, numSamples);
+    output = &buffer;
+  }
+
+  /// Run the effect over this block's input (render thread). Buses on the
+  /// same graph level run this in parallel.
+  void process(int numSamples) {
+    output = &buffer;
+    auto *slot = effect.load(std::memory_order_acquire);
+    jassert(numSamples <= buffer.getNumSamples()); // MixerModel splits blocks
+    if (slot == nullptr || slot->buffer.getNumSamples() < numSamples)
+      return;
+    juce::AudioBuffer<float> block(slot->buffer.getArrayOfWritePointers(),
+                                   slot->buffer.getNumChannels(), numSamples);
+    block.clear();
+    const int channels = juce::jmin(kNumChannels, block.getNumChannels());
+    for (int ch = 0; ch < channels; ++ch)
+      block.copyFrom(ch, 0, buffer, ch, 0, numSamples);
+    midiBuffer.clear();
+    if (resetPending.exchange(false, std::memory_order_acq_rel))
+      slot->instance->reset();
+    slot->instance->processBlock(block, midiBuffer);
+    output = &slot->buffer;
+  }
+
+  /// Sum the processed block into `dest` at the bus fader level.
+  void mixInto(juce::AudioBuffer<float> &dest, int numSamples) {
+    const float to =
+        muted.load(std::memory_order_relaxed)
+            ? 0.0f
+            : juce::Decibels::decibelsToGain(
+                  gainDb.load(std::memory_order_relaxed));
+    const int channels = juce::jmin(dest.getNumChannels(),
+                                    output->getNumChannels(), kNumChannels);
+    for (int ch = 0; ch < channels; ++ch)
+      mixWithGainRamp(dest.getWritePointer(ch), output->getReadPointer(ch),
+                      numSamples, appliedGain, to);
+    appliedGain = to;
+  }
+
+  /// Make a freshly created effect live, with `initialState` restored.
+  /// Message thread only; effects are created by
+  /// MixerModel::loadBusEffect().
+  void installEffect(std::unique_ptr<juce::AudioPluginInstance> instance,
+                     const juce::PluginDescription &desc,
+                     const juce::MemoryBlock &initialState) {
+    loadTicket = 0;
+    editorWindow.reset();
+    auto slot = std::make_unique<EffectSlot>();
+    prepareInstance(*instance, config);
+    if (initialState.getSize() > 0)
+      instance->setStateInformation(initialState.getData(),
+                                    (int)initialState.getSize());
+    slot->buffer.setSize(numChannelsFor(*instance), config.maxBlockSize);
+    slot->instance = std::move(instance);
+    if (mixGeneration)
+      slot->instance->addListener(mixGeneration);
+    effectUid = desc.uniqueId;
+    retire(effect.exchange(slot.release(), std::memory_order_acq_rel));
+
+    std::cerr << "[MixerBus " << name << "] Loaded effect: " << desc.name
+              << std::endl;
+  }
+
+  void unloadEffect() {
+    loadTicket = 0;
+    editorWindow.reset();
+    retire(effect.exchange(nullptr, std::memory_order_acq_rel));
+    effectUid = 0;
+  }
+
+  void showEditor() {
+    auto *instance = getEffect();
+    if (!instance)
+      return;
+    if (editorWindow) {
+      editorWindow->setVisible(true);
+      editorWindow->toFront(true);
+    } else if (auto *editor = instance->createEditor()) {
+      editorWindow = std::make_unique<PluginEditorWindow>(name, editor);
+    }
+  }
+
+  juce::var toJson() const {
+    auto *obj = new juce::DynamicObject();
+    obj->setProperty("id", id);
+    obj->setProperty("name", name);
+    obj->setProperty("kind", kind == Kind::Family ? "family" : "return");
+    obj->setProperty("family", family);
+    obj->setProperty("outputBusId", outputBusId);
+    obj->setProperty("gainDb", gainDb.load(std::memory_order_relaxed));
+    obj->setProperty("muted", muted.load(std::memory_order_relaxed));
+    obj->setProperty("effectUid", effectUid);
+    obj->setProperty("hasEffect", getEffect() != nullptr);
+    return juce::var(obj);
+  }
+
+private:
+  struct EffectSlot {
+    std::unique_ptr<juce::AudioPluginInstance> instance;
+    juce::AudioBuffer<float> buffer;
+  };
+
+  static int numChannelsFor(const juce::AudioPluginInstance &instance) {
+    return juce::jmax(instance.getTotalNumInputChannels(),
+                      instance.getTotalNumOutputChannels(), kNumChannels);
+  }
+
+  void retire(EffectSlot *old) {
+    if (mixGeneration)
+      mixGeneration->bump();
+    if (old == nullptr)
+      return;
+    if (mixGeneration)
+      old->instance->removeListener(mixGeneration);
+    if (rcu)
+      rcu->synchronize();
+    old->instance->releaseResources();
+    delete old;
+  }
+
+  std::atomic<EffectSlot *> effect{nullptr};
+
+  // Render thread only
+  juce::AudioBuffer<float> *output = &buffer;
+  juce::MidiBuffer midiBuffer;
+  float appliedGain = 1.0f;
+};
+
+} // namespace fiddle
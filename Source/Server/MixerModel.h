@@ -1,29 +1,78 @@
 #pragma once
 
 #include "MasterInstrumentList.h"
+#include "MixGeneration.h"
+#include "MixerBus.h"
 #include "MixerStrip.h"
+#include "PluginLoadQueue.h"
+#include "RcuDomain.h"
+#include "RenderConfig.h"
+#include "StripRenderPool.h"
+#include "SubnotePolicy.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <iostream>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <vector>
 
 namespace fiddle {
 
-/// Manages an ordered list of MixerStrips. Owns a shared
-/// AudioPluginFormatManager for plugin instantiation.
+/// Manages an ordered list of MixerStrips and the bus graph they feed. Owns
+/// a shared AudioPluginFormatManager for plugin instantiation.
+///
+/// Each strip sums into its family bus (one per instrument family, created
+/// as families appear) or the master, and can send post-fader to effect
+/// return buses. Buses sum into their output bus or the master. Every bus
+/// has one output, so the graph is a forest rooted at the master; buses
+/// are run deepest first, and buses at the same depth never feed each
+/// other, so their effects run in parallel on the render pool.
+///
+/// Edits happen on the message thread under stripsMutex. The audio side
+/// (device callback, render workers, offline renderer) and the
+/// TrackerEvents dispatcher thread, which routes MIDI, never lock: they
+/// read an immutable Snapshot of the strip list through an atomic pointer,
+/// inside an RCU read guard. Every edit builds a new snapshot, swaps it in,
+/// waits for readers of the old one to leave, and only then frees the old
+/// snapshot and any removed strips.
+///
+/// Every edit that changes how the mix sounds also bumps the MixGeneration,
+/// after the change is visible to the audio side, so the render cache never
+/// replays audio from an older mix.
 class MixerModel {
 public:
-  MixerModel() { formatManager_.addFormat(new juce::VST3PluginFormat()); }
+  MixerModel() {
+    formatManager_.addFormat(new juce::VST3PluginFormat());
+    snapshot_.store(new Snapshot(), std::memory_order_release);
+  }
 
-  ~MixerModel() { clear(); }
+  ~MixerModel() {
+    *alive_ = false; // Loads still in flight find no model to land in
+    clear();
+    delete snapshot_.load(std::memory_order_acquire);
+  }
 
   void clear() {
-    std::lock_guard<std::mutex> lock(stripsMutex);
-    for (auto &strip : strips_) {
-      strip->unloadPlugin();
+    loadQueue_.cancel();
+    std::vector<std::unique_ptr<MixerStrip>> removed;
+    std::vector<std::unique_ptr<MixerBus>> removedBuses;
+    {
+      std::lock_guard<std::mutex> lock(stripsMutex);
+      removed = std::move(strips_);
+      strips_.clear();
+      removedBuses = std::move(buses_);
+      buses_.clear();
+      publish();
     }
-    strips_.clear();
+    for (auto &strip : removed)
+      strip->unloadPlugin();
+    for (auto &bus : removedBuses)
+      bus->unloadEffect();
   }
 
   /// Add a new empty strip. Returns its ID.
@@ -33,24 +82,64 @@ public:
     strip->name = "Strip " + juce::String(nextStripNumber_++);
 
     std::lock_guard<std::mutex> lock(stripsMutex);
-    strip->prepareToPlay(currentSampleRate_, currentBlockSize_);
+    strip->rcu = &rcu_;
+    strip->mixGeneration = &mixGeneration_;
+    strip->prepareToPlay(config_);
     strips_.push_back(std::move(strip));
+    publish();
     return strips_.back()->id;
   }
 
   /// Remove a strip by ID.
   bool removeStrip(const juce::String &id) {
+    std::unique_ptr<MixerStrip> removed;
+    {
+      std::lock_guard<std::mutex> lock(stripsMutex);
+      for (auto it = strips_.begin(); it != strips_.end(); ++it) {
+        if ((*it)->id == id) {
+          removed = std::move(*it);
+          strips_.erase(it);
+          publish();
+          break;
+        }
+      }
+    }
+    if (!removed)
+      return false;
+    removed->unloadPlugin();
+    return true;
+  }
+
+  /// Reassign a strip's MIDI input (-1 = unassigned).
+  bool setStripInput(const juce::String &id, int port, int channel) {
     std::lock_guard<std::mutex> lock(stripsMutex);
-    for (auto it = strips_.begin(); it != strips_.end(); ++it) {
-      if ((*it)->id == id) {
-        (*it)->unloadPlugin();
-        strips_.erase(it);
+    for (auto &s : strips_) {
+      if (s->id == id) {
+        s->inputPort = port;
+        s->inputChannel = channel;
+        publish();
         return true;
       }
     }
     return false;
   }
 
+  /// The subnote policy for every input: the strip's own settings over its
+  /// family's policy, else the default. Inputs without a strip get the
+  /// default.
+  SubnotePolicyTable resolveSubnotePolicies() const {
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    SubnotePolicyTable table;
+    table.fallback = subnotePolicies_.defaults;
+    table.byInput.fill(subnotePolicies_.defaults);
+    for (const auto &s : strips_) {
+      if (auto *slot = table.inputSlot(s->inputPort, s->inputChannel))
+        *slot = s->subnotePolicy.appliedTo(
+            subnotePolicies_.forFamily(s->family));
+    }
+    return table;
+  }
+
   /// Find a strip by ID (nullptr if not found).
   MixerStrip *getStrip(const juce::String &id) {
     std::lock_guard<std::mutex> lock(stripsMutex);
@@ -64,47 +153,432 @@ public:
   /// Get the shared format manager (for plugin loading).
   juce::AudioPluginFormatManager &getFormatManager() { return formatManager_; }
 
+  /// Background loader for config loads.
+  PluginLoadQueue &getLoadQueue() { return loadQueue_; }
+
+  /// Load a plugin into strip `id`, in a worker process if the strip is
+  /// sandboxed. Message thread. Creation is asynchronous, so the result
+  /// goes by strip ID and load ticket, never by pointer: it is dropped,
+  /// and `onComplete` gets false, if by then the strip has been removed,
+  /// the mixer cleared or reloaded, or a later load or an unload has
+  /// superseded it.
+  void loadStripPlugin(const juce::String &id,
+                       const juce::PluginDescription &desc,
+                       std::function<void(bool)> onComplete = nullptr,
+                       juce::MemoryBlock initialState = {}) {
+    auto *strip = getStrip(id);
+    if (strip == nullptr) {
+      if (onComplete)
+        onComplete(false);
+      return;
+    }
+    const uint64_t ticket = strip->loadTicket = ++nextLoadTicket_;
+    // A sandbox restores the state inside its worker, while it loads
+    const bool sandboxed = strip->sandboxed;
+    auto onCreated =
+        [this, alive = alive_, id, ticket, desc, onComplete, initialState,
+         sandboxed](std::unique_ptr<juce::AudioPluginInstance> instance,
+                    const juce::String &error) {
+          if (!*alive)
+            return;
+          auto *s = getStrip(id);
+          if (s == nullptr || s->loadTicket != ticket) {
+            std::cerr << "[MixerModel] Dropping superseded load of "
+                      << desc.name << std::endl;
+            if (onComplete)
+              onComplete(false);
+            return;
+          }
+          if (!instance) {
+            s->loadTicket = 0;
+            std::cerr << "[MixerStrip " << id << "] Failed to load "
+                      << desc.name << ": " << error << std::endl;
+            if (onComplete)
+              onComplete(false);
+            return;
+          }
+          s->installPlugin(std::move(instance), desc, initialState, sandboxed);
+          if (onComplete)
+            onComplete(true);
+        };
+
+    const auto &config = strip->config;
+    if (sandboxed)
+      SandboxedPluginInstance::createAsync(desc, config.sampleRate,
+                                           config.maxBlockSize, initialState,
+                                           onCreated);
+    else
+      formatManager_.createPluginInstanceAsync(desc, config.sampleRate,
+                                               config.maxBlockSize, onCreated);
+  }
+
+  /// Load an effect into return bus `id`. Message thread; the result is
+  /// handled like loadStripPlugin()'s.
+  void loadBusEffect(const juce::String &id,
+                     const juce::PluginDescription &desc,
+                     std::function<void(bool)> onComplete = nullptr,
+                     juce::MemoryBlock initialState = {}) {
+    auto *bus = getBus(id);
+    if (bus == nullptr) {
+      if (onComplete)
+        onComplete(false);
+      return;
+    }
+    const uint64_t ticket = bus->loadTicket = ++nextLoadTicket_;
+    formatManager_.createPluginInstanceAsync(
+        desc, bus->config.sampleRate, bus->config.maxBlockSize,
+        [this, alive = alive_, id, ticket, desc, onComplete, initialState](
+            std::unique_ptr<juce::AudioPluginInstance> instance,
+            const juce::String &error) {
+          if (!*alive)
+            return;
+          auto *b = getBus(id);
+          if (b == nullptr || b->loadTicket != ticket) {
+            std::cerr << "[MixerModel] Dropping superseded load of "
+                      << desc.name << std::endl;
+            if (onComplete)
+              onComplete(false);
+            return;
+          }
+          if (!instance) {
+            b->loadTicket = 0;
+            std::cerr << "[MixerBus " << b->name << "] Failed to load "
+                      << desc.name << ": " << error << std::endl;
+            if (onComplete)
+              onComplete(false);
+            return;
+          }
+          b->installEffect(std::move(instance), desc, initialState);
+          if (onComplete)
+            onComplete(true);
+        });
+  }
+
   /// Get all strips count.
   int size() const {
     std::lock_guard<std::mutex> lock(stripsMutex);
     return static_cast<int>(strips_.size());
   }
 
-  /// Serialize all strips to JSON array.
+  /// Serialize all strips to JSON array. "layers" is how many strips share
+  /// the strip's input (fan-out), 0 if unassigned.
   juce::String toJson() const {
     juce::Array<juce::var> arr;
     std::lock_guard<std::mutex> lock(stripsMutex);
-    for (const auto &s : strips_)
-      arr.add(s->toJson());
+    const auto &snap = *snapshot_.load(std::memory_order_acquire);
+    for (const auto &s : strips_) {
+      auto json = s->toJson();
+      int route = routeIndex(s->inputPort, s->inputChannel);
+      json.getDynamicObject()->setProperty(
+          "layers", route < 0 ? 0
+                              : (int)(snap.routeStart[(size_t)route + 1] -
+                                      snap.routeStart[(size_t)route]));
+      arr.add(json);
+    }
     return juce::JSON::toString(juce::var(arr), true);
   }
 
-  /// Process the audio block for all strips
-  void processBlock(juce::AudioBuffer<float> &audioBuffer, double currentTime) {
+  /// Process the audio block for all strips. Strips render in parallel on
+  /// the render pool, heaviest first by measured cost, then are summed here
+  /// in strip order into their buses, and the bus graph is run level by
+  /// level into `audioBuffer`. Lock-free.
+  ///
+  /// `blockStart` is the trigger-time clock at the first sample and
+  /// `timePerSample` its rate; see MixerStrip::renderBlock().
+  ///
+  /// Sandboxed strips all wait for their workers until one deadline, a
+  /// fixed fraction of the block from when this call starts, so the mix
+  /// still has the rest of the block however many of them run in turn.
+  ///
+  /// Every buffer below holds the prepared maximum block size, so a longer
+  /// block (some devices deliver more than they announce) is rendered in
+  /// pieces of that size rather than dropped or reallocated.
+  void processBlock(juce::AudioBuffer<float> &audioBuffer, double blockStart,
+                    double timePerSample) {
+    const int total = audioBuffer.getNumSamples();
+    const int maxBlock = juce::jmax(1, config_.maxBlockSize);
+    const juce::int64 deadline =
+        juce::Time::getHighResolutionTicks() +
+        juce::Time::secondsToHighResolutionTicks(
+            SandboxedPluginInstance::kDeadlineFraction * total /
+            config_.sampleRate);
+    if (total <= maxBlock) {
+      renderSubBlock(audioBuffer, blockStart, timePerSample, deadline);
+      return;
+    }
+    for (int start = 0; start < total; start += maxBlock) {
+      juce::AudioBuffer<float> part(audioBuffer.getArrayOfWritePointers(),
+                                    audioBuffer.getNumChannels(), start,
+                                    juce::jmin(maxBlock, total - start));
+      renderSubBlock(part, blockStart + start * timePerSample, timePerSample,
+                     deadline);
+    }
+  }
+
+  // ── Buses ──
+
+  /// Add an effect return bus. Returns its ID.
+  juce::String addReturnBus() {
+    auto bus = std::make_unique<MixerBus>();
+    bus->id = juce::Uuid().toString();
+    bus->kind = MixerBus::Kind::Return;
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    int number = 1;
+    for (auto &b : buses_)
+      number += b->kind == MixerBus::Kind::Return ? 1 : 0;
+    bus->name = "FX " + juce::String(number);
+    bus->rcu = &rcu_;
+    bus->mixGeneration = &mixGeneration_;
+    bus->prepareToPlay(config_);
+    buses_.push_back(std::move(bus));
+    publish();
+    return buses_.back()->id;
+  }
+
+  /// Get (creating if needed) the bus for an instrument family. Family buses
+  /// otherwise appear as strips of that family do; config load uses this to
+  /// restore their settings first. Returns its ID.
+  juce::String addFamilyBus(const juce::String &family) {
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    auto id = familyBus(family)->id;
+    publish();
+    return id;
+  }
+
+  /// Remove a return bus and every send to it. Family buses follow the
+  /// strips' families and can't be removed.
+  bool removeBus(const juce::String &id) {
+    std::unique_ptr<MixerBus> removed;
+    std::vector<std::unique_ptr<MixerStrip::Send>> removedSends;
+    {
+      std::lock_guard<std::mutex> lock(stripsMutex);
+      for (auto it = buses_.begin(); it != buses_.end(); ++it) {
+        if ((*it)->id == id && (*it)->kind == MixerBus::Kind::Return) {
+          removed = std::move(*it);
+          buses_.erase(it);
+          break;
+        }
+      }
+      if (!removed)
+        return false;
+      for (auto &s : strips_) {
+        for (auto it = s->sends.begin(); it != s->sends.end();) {
+          if ((*it)->busId == id) {
+            removedSends.push_back(std::move(*it));
+            it = s->sends.erase(it);
+          } else {
+            ++it;
+          }
+        }
+      }
+      for (auto &b : buses_)
+        if (b->outputBusId == id)
+          b->outputBusId = {};
+      publish();
+    }
+    removed->unloadEffect();
+    return true;
+  }
+
+  MixerBus *getBus(const juce::String &id) {
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    for (auto &b : buses_)
+      if (b->id == id)
+        return b.get();
+    return nullptr;
+  }
+
+  bool setBusMix(const juce::String &id, float gainDb, bool muted) {
     std::lock_guard<std::mutex> lock(stripsMutex);
-    for (auto &strip : strips_) {
-      strip->processBlock(audioBuffer, currentTime);
+    for (auto &b : buses_) {
+      if (b->id == id) {
+        b->gainDb.store(juce::jlimit(kMinGainDb, kMaxGainDb, gainDb),
+                        std::memory_order_relaxed);
+        b->muted.store(muted, std::memory_order_relaxed);
+        mixGeneration_.bump();
+        return true;
+      }
     }
+    return false;
   }
 
-  void prepareToPlay(double sampleRate, int blockSize) {
+  /// Route a bus into another bus (empty = master). A route that would
+  /// close a loop falls back to the master when the graph is built.
+  bool setBusOutput(const juce::String &id, const juce::String &outputBusId) {
     std::lock_guard<std::mutex> lock(stripsMutex);
-    currentSampleRate_ = sampleRate;
-    currentBlockSize_ = blockSize;
-    for (auto &strip : strips_) {
-      strip->prepareToPlay(sampleRate, blockSize);
+    for (auto &b : buses_) {
+      if (b->id == id) {
+        b->outputBusId = outputBusId == id ? juce::String() : outputBusId;
+        publish();
+        return true;
+      }
     }
+    return false;
   }
 
-  /// Route incoming MIDI note event to matching strips
-  void routeNoteEvent(int port, int channel, const juce::MidiMessage &msg,
-                      double triggerTime) {
+  /// Set a strip's post-fader send level to a return bus, creating the send
+  /// on first use.
+  bool setStripSend(const juce::String &stripId, const juce::String &busId,
+                    float gainDb) {
     std::lock_guard<std::mutex> lock(stripsMutex);
-    for (auto &strip : strips_) {
-      if (strip->inputPort == port && strip->inputChannel == channel) {
-        strip->addDelayedMessage(triggerTime, msg);
+    bool busExists = false;
+    for (auto &b : buses_)
+      busExists |= b->id == busId && b->kind == MixerBus::Kind::Return;
+    if (!busExists)
+      return false;
+    for (auto &s : strips_) {
+      if (s->id != stripId)
+        continue;
+      gainDb = juce::jlimit(kMinGainDb, kMaxGainDb, gainDb);
+      if (auto *send = s->findSend(busId)) {
+        send->gainDb.store(gainDb, std::memory_order_relaxed);
+        mixGeneration_.bump();
+      } else {
+        auto newSend = std::make_unique<MixerStrip::Send>();
+        newSend->busId = busId;
+        newSend->gainDb.store(gainDb, std::memory_order_relaxed);
+        s->sends.push_back(std::move(newSend));
+        publish();
       }
+      return true;
     }
+    return false;
+  }
+
+  /// Serialize all buses to a JSON array.
+  juce::String busesToJson() const {
+    juce::Array<juce::var> arr;
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    for (const auto &b : buses_)
+      arr.add(b->toJson());
+    return juce::JSON::toString(juce::var(arr), true);
+  }
+
+  /// Strips that auto-slept through the last rendered block.
+  int getNumAsleep() const {
+    return numAsleep_.load(std::memory_order_relaxed);
+  }
+
+  /// IDs of sleeping strips as a JSON array.
+  juce::String sleepingToJson() const {
+    juce::Array<juce::var> arr;
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    for (const auto &s : strips_)
+      if (s->isAsleep())
+        arr.add(s->id);
+    return juce::JSON::toString(juce::var(arr), true);
+  }
+
+  /// Set a strip's fader section. Takes effect (ramped) at the next block.
+  bool setStripMix(const juce::String &id, float gainDb, float pan,
+                   bool muted, bool soloed) {
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    for (auto &s : strips_) {
+      if (s->id == id) {
+        s->gainDb.store(juce::jlimit(kMinGainDb, kMaxGainDb, gainDb),
+                        std::memory_order_relaxed);
+        s->pan.store(juce::jlimit(-1.0f, 1.0f, pan), std::memory_order_relaxed);
+        s->muted.store(muted, std::memory_order_relaxed);
+        s->soloed.store(soloed, std::memory_order_relaxed);
+        mixGeneration_.bump();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Bypass or re-enable a strip. Takes effect at the next block.
+  bool setStripBypass(const juce::String &id, bool bypass) {
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    for (auto &s : strips_) {
+      if (s->id == id) {
+        s->bypassed.store(bypass, std::memory_order_relaxed);
+        mixGeneration_.bump();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Per-strip DSP load as a JSON object {stripId: fraction of the block}.
+  juce::String loadsToJson() const {
+    auto *obj = new juce::DynamicObject();
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    for (const auto &s : strips_)
+      obj->setProperty(s->id, s->cpuLoad.load(std::memory_order_relaxed));
+    return juce::JSON::toString(juce::var(obj), true);
+  }
+
+  /// Drop pending MIDI and silence every strip (transport stop/locate).
+  /// Called from the TrackerEvents dispatcher thread, like routeEvent().
+  void flush() {
+    auto guard = rcu_.read();
+    const auto &snap = *snapshot_.load(std::memory_order_acquire);
+    for (auto *strip : snap.strips)
+      strip->flush();
+    for (auto *bus : snap.buses)
+      bus->resetPending.store(true, std::memory_order_release);
+  }
+
+  /// Re-prepare every strip, bus and plugin for `config`. Message thread,
+  /// only while the audio device is stopped and no offline render runs.
+  /// Plugins can take a while to prepare, so that happens outside
+  /// stripsMutex; the lists it walks only change on this thread.
+  void prepareToPlay(const RenderConfig &config) {
+    std::vector<MixerStrip *> strips;
+    std::vector<MixerBus *> buses;
+    {
+      std::lock_guard<std::mutex> lock(stripsMutex);
+      config_ = config;
+      for (auto &strip : strips_)
+        strips.push_back(strip.get());
+      for (auto &bus : buses_)
+        buses.push_back(bus.get());
+    }
+    for (auto *strip : strips)
+      strip->prepareToPlay(config);
+    for (auto *bus : buses)
+      bus->prepareToPlay(config);
+    mixGeneration_.bump();
+
+    // One worker per core besides the audio thread itself
+    renderPool_.reset();
+    int numWorkers = juce::jlimit(0, kMaxRenderWorkers,
+                                  juce::SystemStats::getNumCpus() - 1);
+    renderPool_ = std::make_unique<StripRenderPool>(
+        numWorkers, config.sampleRate, config.maxBlockSize);
+  }
+
+
+  /// Tell every plugin whether it is rendering offline (export), so samplers
+  /// can trade speed for quality. Not called while processBlock() runs.
+  void setNonRealtime(bool isNonRealtime) {
+    auto guard = rcu_.read();
+    for (auto *strip : snapshot_.load(std::memory_order_acquire)->strips)
+      strip->setNonRealtime(isNonRealtime);
+  }
+
+  /// Consume due MIDI on every strip without rendering (cached block).
+  void skipBlock(int numSamples, double blockStart, double timePerSample) {
+    auto guard = rcu_.read();
+    for (auto *strip : snapshot_.load(std::memory_order_acquire)->strips)
+      strip->skipBlock(numSamples, blockStart, timePerSample);
+  }
+
+  /// Route an incoming note, controller, pitch bend or pressure message to
+  /// every strip on its input. Several strips may share an input to layer
+  /// sounds; the lookup is one table index either way. TrackerEvents
+  /// dispatcher thread only: it is each strip's single MIDI producer.
+  void routeEvent(int port, int channel, const juce::MidiMessage &msg,
+                  double triggerTime) {
+    const int route = routeIndex(port, channel);
+    if (route < 0)
+      return;
+    auto guard = rcu_.read();
+    const auto &snap = *snapshot_.load(std::memory_order_acquire);
+    for (uint32_t i = snap.routeStart[(size_t)route];
+         i < snap.routeStart[(size_t)route + 1]; ++i)
+      snap.routeTargets[i]->addDelayedMessage(triggerTime, msg);
   }
 
   /// Sync mixer strips to match the ensemble instrument list.
@@ -159,13 +633,14 @@ public:
       }
     }
 
+    std::vector<std::unique_ptr<MixerStrip>> removed;
     std::lock_guard<std::mutex> lock(stripsMutex);
 
     // Remove strips whose port/channel is no longer in the expected set
     for (auto it = strips_.begin(); it != strips_.end();) {
       auto key = std::make_pair((*it)->inputPort, (*it)->inputChannel);
       if (expectedSet.find(key) == expectedSet.end()) {
-        (*it)->unloadPlugin();
+        removed.push_back(std::move(*it));
         it = strips_.erase(it);
       } else {
         ++it;
@@ -202,24 +677,299 @@ public:
         strip->isSolo = entry.isSolo;
         strip->inputPort = entry.port;
         strip->inputChannel = entry.channel;
-        strip->prepareToPlay(currentSampleRate_, currentBlockSize_);
+        strip->rcu = &rcu_;
+        strip->mixGeneration = &mixGeneration_;
+        strip->prepareToPlay(config_);
         strips_.push_back(std::move(strip));
       }
     }
+
+    publish();
+    for (auto &strip : removed)
+      strip->unloadPlugin();
   }
 
 private:
-  mutable std::mutex stripsMutex;
+  static constexpr int kMaxRenderWorkers = 15;
+  static constexpr float kMinGainDb = -100.0f; // decibelsToGain() floor
+  static constexpr float kMaxGainDb = 12.0f;
+
+  static constexpr int kNumPorts = 16;
+  static constexpr int kNumRoutes = kNumPorts * 16; // port × channel
+
+  /// Routing table slot for a 0-based port and channel, or -1 if none.
+  static int routeIndex(int port, int channel) {
+    if (port < 0 || port >= kNumPorts || channel < 0 || channel >= 16)
+      return -1;
+    return port * 16 + channel;
+  }
+
+  /// Immutable view of the strip list for lock-free readers. Input routing
+  /// is resolved into the table here, so readers never see a half-edited
+  /// strip assignment.
+  struct Snapshot {
+    std::vector<MixerStrip *> strips; // mix order
+    mutable std::vector<float> costs; // render scratch, sized to strips
+
+    // Strips on route r are routeTargets[routeStart[r] .. routeStart[r+1])
+    std::array<uint32_t, kNumRoutes + 1> routeStart{};
+    std::vector<MixerStrip *> routeTargets;
+
+    // Bus graph. Indices are into `buses`; -1 is the master.
+    std::vector<MixerBus *> buses; // deepest level first
+    std::vector<int> busOutput;
+    std::vector<int> levelStart; // level l is [levelStart[l], levelStart[l+1])
+    std::vector<int> stripOutput; // per strip
+    struct SendEntry {
+      MixerStrip *strip;
+      MixerStrip::Send *send;
+      int bus;
+    };
+    std::vector<SendEntry> sends;
+    mutable std::vector<float> busCosts; // render scratch
+  };
+
+  static juce::String familyBusId(const juce::String &family) {
+    return "family:" + family;
+  }
+
+  /// Find or create the bus for `family`. Caller holds stripsMutex and
+  /// publishes.
+  MixerBus *familyBus(const juce::String &family) {
+    auto id = familyBusId(family);
+    for (auto &b : buses_)
+      if (b->id == id)
+        return b.get();
+    auto bus = std::make_unique<MixerBus>();
+    bus->id = id;
+    bus->name = family;
+    bus->family = family;
+    bus->kind = MixerBus::Kind::Family;
+    bus->rcu = &rcu_;
+    bus->mixGeneration = &mixGeneration_;
+    bus->prepareToPlay(config_);
+    buses_.push_back(std::move(bus));
+    return buses_.back().get();
+  }
+
+  /// Make sure every strip family has a bus. Caller holds stripsMutex.
+  void ensureFamilyBuses() {
+    for (auto &s : strips_)
+      if (s->family.isNotEmpty())
+        familyBus(s->family);
+  }
+
+  /// Resolve the bus graph into `next`: depth of each bus below the master
+  /// (loops broken by routing to the master), then buses grouped by depth,
+  /// deepest first.
+  void buildBusGraph(Snapshot &next) const {
+    const int numBuses = (int)buses_.size();
+    auto indexOf = [&](const juce::String &id) {
+      for (int i = 0; i < numBuses; ++i)
+        if (buses_[(size_t)i]->id == id)
+          return i;
+      return -1;
+    };
+
+    std::vector<int> output((size_t)numBuses);
+    for (int i = 0; i < numBuses; ++i)
+      output[(size_t)i] = buses_[(size_t)i]->outputBusId.isEmpty()
+                              ? -1
+                              : indexOf(buses_[(size_t)i]->outputBusId);
+
+    std::vector<int> depth((size_t)numBuses, 0);
+    for (int i = 0; i < numBuses; ++i) {
+      int d = 0;
+      for (int b = output[(size_t)i]; b >= 0; b = output[(size_t)b]) {
+        if (++d > numBuses) { // Walked a loop
+          std::cerr << "[MixerModel] Bus " << buses_[(size_t)i]->name
+                    << " routes in a loop; sending it to the master"
+                    << std::endl;
+          output[(size_t)i] = -1;
+          d = 0;
+          break;
+        }
+      }
+      depth[(size_t)i] = d;
+    }
+    // A broken loop can shorten other chains; recompute once settled
+    for (int i = 0; i < numBuses; ++i) {
+      int d = 0;
+      for (int b = output[(size_t)i]; b >= 0; b = output[(size_t)b])
+        ++d;
+      depth[(size_t)i] = d;
+    }
+
+    std::vector<int> order((size_t)numBuses);
+    for (int i = 0; i < numBuses; ++i)
+      order[(size_t)i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+      return depth[(size_t)a] > depth[(size_t)b];
+    });
+    std::vector<int> position((size_t)numBuses);
+    for (int k = 0; k < numBuses; ++k)
+      position[(size_t)order[(size_t)k]] = k;
+
+    for (int k = 0; k < numBuses; ++k) {
+      int i = order[(size_t)k];
+      next.buses.push_back(buses_[(size_t)i].get());
+      int out = output[(size_t)i];
+      next.busOutput.push_back(out < 0 ? -1 : position[(size_t)out]);
+      if (k == 0 || depth[(size_t)i] != depth[(size_t)order[(size_t)k - 1]])
+        next.levelStart.push_back(k);
+    }
+    next.levelStart.push_back(numBuses);
+    next.busCosts.resize((size_t)numBuses);
+
+    auto positionOf = [&](const juce::String &id) {
+      int i = indexOf(id);
+      return i < 0 ? -1 : position[(size_t)i];
+    };
+    for (auto &s : strips_) {
+      next.stripOutput.push_back(
+          s->family.isEmpty() ? -1 : positionOf(familyBusId(s->family)));
+      for (auto &send : s->sends)
+        if (int bus = positionOf(send->busId); bus >= 0)
+          next.sends.push_back({s.get(), send.get(), bus});
+    }
+  }
+
+  /// Swap in a snapshot of strips_ and buses_ and free the old one once no
+  /// reader can hold it. Caller holds stripsMutex; strips, buses and sends
+  /// removed from the model must stay alive until this returns.
+  void publish() {
+    ensureFamilyBuses();
+    auto *next = new Snapshot();
+    next->strips.reserve(strips_.size());
+    for (auto &s : strips_)
+      next->strips.push_back(s.get());
+    next->costs.resize(next->strips.size());
+
+    // Counting sort by route, keeping strip order within each route
+    for (auto &s : strips_)
+      if (int r = routeIndex(s->inputPort, s->inputChannel); r >= 0)
+        ++next->routeStart[(size_t)r + 1];
+    for (int r = 0; r < kNumRoutes; ++r)
+      next->routeStart[(size_t)r + 1] += next->routeStart[(size_t)r];
+    next->routeTargets.resize(next->routeStart[kNumRoutes]);
+    auto fill = next->routeStart;
+    for (auto &s : strips_)
+      if (int r = routeIndex(s->inputPort, s->inputChannel); r >= 0)
+        next->routeTargets[fill[(size_t)r]++] = s.get();
+    buildBusGraph(*next);
+
+    auto *old = snapshot_.exchange(next, std::memory_order_acq_rel);
+    mixGeneration_.bump();
+    rcu_.synchronize();
+    delete old;
+  }
+
+  /// One block of at most config_.maxBlockSize samples; see processBlock().
+  void renderSubBlock(juce::AudioBuffer<float> &audioBuffer,
+                      double blockStart, double timePerSample,
+                      juce::int64 deadline) {
+    auto guard = rcu_.read();
+    const auto &snap = *snapshot_.load(std::memory_order_acquire);
+    const int numSamples = audioBuffer.getNumSamples();
+    const double blockMs = numSamples * 1000.0 / config_.sampleRate;
+    const int count = (int)snap.strips.size();
+
+    for (int i = 0; i < count; ++i)
+      snap.costs[(size_t)i] = snap.strips[(size_t)i]->renderCostMs;
+
+    auto render = [&](int i) {
+      auto &strip = *snap.strips[(size_t)i];
+      auto start = juce::Time::getHighResolutionTicks();
+      strip.renderBlock(numSamples, blockStart, timePerSample, deadline);
+      strip.recordRenderTime(
+          juce::Time::highResolutionTicksToSeconds(
+              juce::Time::getHighResolutionTicks() - start) *
+              1000.0,
+          blockMs);
+    };
+    if (renderPool_)
+      renderPool_->run(count, snap.costs.data(), render);
+    else
+      for (int i = 0; i < count; ++i)
+        render(i);
+
+    // Summing stage: each strip's fused gain/pan multiply-add into its bus
+    for (auto *bus : snap.buses)
+      bus->beginBlock(numSamples);
+    auto destination = [&](int busIndex) -> juce::AudioBuffer<float> & {
+      return busIndex < 0 ? audioBuffer : snap.buses[(size_t)busIndex]->buffer;
+    };
+    bool soloActive = false;
+    for (auto *strip : snap.strips)
+      soloActive |= strip->soloed.load(std::memory_order_relaxed);
+    int asleep = 0;
+    for (int i = 0; i < count; ++i) {
+      auto *strip = snap.strips[(size_t)i];
+      strip->mixInto(destination(snap.stripOutput[(size_t)i]), soloActive);
+      asleep += strip->isAsleep() ? 1 : 0;
+    }
+    for (const auto &send : snap.sends)
+      send.strip->sendInto(destination(send.bus), *send.send);
+    numAsleep_.store(asleep, std::memory_order_relaxed);
+
+    // Bus graph, deepest level first; a level's effects run in parallel
+    for (size_t level = 0; level + 1 < snap.levelStart.size(); ++level) {
+      const int first = snap.levelStart[level];
+      const int n = snap.levelStart[level + 1] - first;
+      for (int i = 0; i < n; ++i)
+        snap.busCosts[(size_t)i] =
+            snap.buses[(size_t)(first + i)]->renderCostMs;
+      auto processBus = [&](int i) {
+        auto &bus = *snap.buses[(size_t)(first + i)];
+        auto start = juce::Time::getHighResolutionTicks();
+        bus.process(numSamples);
+        auto ms = (float)(juce::Time::highResolutionTicksToSeconds(
+                              juce::Time::getHighResolutionTicks() - start) *
+                          1000.0);
+        bus.renderCostMs += 0.1f * (ms - bus.renderCostMs);
+      };
+      if (renderPool_)
+        renderPool_->run(n, snap.busCosts.data(), processBus);
+      else
+        for (int i = 0; i < n; ++i)
+          processBus(i);
+      for (int i = first; i < first + n; ++i)
+        snap.buses[(size_t)i]->mixInto(destination(snap.busOutput[(size_t)i]),
+                                       numSamples);
+    }
+  }
+
+  mutable std::mutex stripsMutex; // writers (message thread) only
   std::vector<std::unique_ptr<MixerStrip>> strips_;
+  std::vector<std::unique_ptr<MixerBus>> buses_;
+  RcuDomain rcu_;
+  MixGeneration mixGeneration_;
+  std::atomic<const Snapshot *> snapshot_{nullptr};
   juce::AudioPluginFormatManager formatManager_;
+  PluginLoadQueue loadQueue_;
+  std::unique_ptr<StripRenderPool> renderPool_;
+  std::atomic<int> numAsleep_{0};
   int nextStripNumber_ = 1;
-  double currentSampleRate_ = 44100.0;
-  int currentBlockSize_ = 512;
+  uint64_t nextLoadTicket_ = 0; // message thread
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+  RenderConfig config_;
   int playbackDelayMs_ = 1000;
+  SubnotePolicies subnotePolicies_;
 
 public:
+  const RenderConfig &getRenderConfig() const { return config_; }
+  const MixGeneration &getMixGeneration() const { return mixGeneration_; }
+  double getSampleRate() const { return config_.sampleRate; }
+  int getBlockSize() const { return config_.maxBlockSize; }
   int getPlaybackDelayMs() const { return playbackDelayMs_; }
   void setPlaybackDelayMs(int ms) { playbackDelayMs_ = ms; }
+  const SubnotePolicies &getSubnotePolicies() const {
+    return subnotePolicies_;
+  }
+  void setSubnotePolicies(SubnotePolicies policies) {
+    std::lock_guard<std::mutex> lock(stripsMutex);
+    subnotePolicies_ = std::move(policies);
+  }
 };
 
 } // namespace fiddle
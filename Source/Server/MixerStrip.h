@@ -1,8 +1,17 @@
 #pragma once
 
+#include "MidiScheduleQueue.h"
+#include "MixGeneration.h"
+#include "MixKernel.h"
 #include "PluginEditorWindow.h"
+#include "PluginSandbox.h"
+#include "RcuDomain.h"
+#include "RenderConfig.h"
+#include "SubnotePolicy.h"
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <juce_audio_processors/juce_audio_processors.h>
-#include <mutex>
 #include <vector>
 
 namespace fiddle {
@@ -19,144 +28,338 @@ struct MixerStrip {
   int inputPort = -1;
   int inputChannel = -1;
 
+  // Overrides parts of the family's subnote policy (config YAML: `subnotes`)
+  SubnotePolicyOverride subnotePolicy;
+
   // Plugin
   int pluginUid = 0; // scanned plugin uniqueId (0 = none)
-  std::unique_ptr<juce::AudioPluginInstance> pluginInstance;
+  bool sandboxed = false; // host the plugin in a worker process; next load
+  // The latest load MixerModel::loadStripPlugin() started (0 = none). Only
+  // that load's result is installed; unloading cancels it.
+  uint64_t loadTicket = 0;
   std::unique_ptr<PluginEditorWindow> editorWindow;
 
-  std::mutex processMutex;
-  std::mutex midiMutex;
-  std::vector<std::pair<double, juce::MidiMessage>> delayedMessages;
-  double currentSampleRate = 44100.0;
-  int currentBlockSize = 512;
+  /// A plugin instance together with the buffer it renders into. Swapped as
+  /// a unit so the audio thread never sees a plugin with a mis-sized buffer.
+  struct PluginSlot {
+    std::unique_ptr<juce::AudioPluginInstance> instance;
+    juce::AudioBuffer<float> buffer;
+    int64_t sleepAfterSamples = -1; // silence before auto-sleep; -1 = never
+    bool mono = false;              // single output: pan channel 0 to both
+    SandboxedPluginInstance *sandbox = nullptr; // `instance`, if sandboxed
+  };
+
+  /// User bypass: the strip consumes its MIDI but neither renders nor mixes.
+  std::atomic<bool> bypassed{false};
+
+  // Fader section, set from the message thread. Not to be confused with
+  // isSolo (solo player vs section): `soloed` is the mixer's solo button.
+  std::atomic<float> gainDb{0.0f};
+  std::atomic<float> pan{0.0f}; // -1 (left) .. +1 (right)
+  std::atomic<bool> muted{false};
+  std::atomic<bool> soloed{false};
+
+  /// Post-fader send to an effect return bus. The list is edited on the
+  /// message thread and published with the strip list; the level is live.
+  struct Send {
+    juce::String busId;
+    std::atomic<float> gainDb{-100.0f};
+    float applied = 0.0f; // render thread: last linear level used
+  };
+  std::vector<std::unique_ptr<Send>> sends;
+
+  Send *findSend(const juce::String &busId) const {
+    for (auto &send : sends)
+      if (send->busId == busId)
+        return send.get();
+    return nullptr;
+  }
 
-  juce::AudioBuffer<float> tempBuffer;
+  /// Auto-sleep: set by the render thread once the strip has been silent,
+  /// with no held notes, for longer than its plugin's tail. A sleeping strip
+  /// skips processBlock() until its next scheduled event.
+  bool isAsleep() const { return asleep.load(std::memory_order_relaxed); }
 
-  void prepareToPlay(double sampleRate, int blockSize) {
-    std::lock_guard<std::mutex> lock(processMutex);
-    currentSampleRate = sampleRate;
-    currentBlockSize = blockSize;
-    if (pluginInstance) {
-      int maxChannels =
-          juce::jmax(pluginInstance->getTotalNumInputChannels(),
-                     pluginInstance->getTotalNumOutputChannels(), 2);
-      tempBuffer.setSize(maxChannels, blockSize);
-      pluginInstance->prepareToPlay(sampleRate, blockSize);
+  /// Set by MixerModel when the strip is created. Plugin swaps wait on it
+  /// before freeing the old slot.
+  RcuDomain *rcu = nullptr;
+
+  /// Set by MixerModel when the strip is created. Bumped when the plugin is
+  /// swapped, and listens to the loaded plugin for edits to its settings.
+  MixGeneration *mixGeneration = nullptr;
+
+  /// What the strip was last prepared for; slot buffers hold
+  /// config.maxBlockSize samples.
+  RenderConfig config;
+
+  // Render cost model. renderCostMs is a moving average of recent blocks
+  // (audio thread only, used for scheduling); cpuLoad is that as a fraction
+  // of the block duration, for the mixer UI.
+  float renderCostMs = 0.0f;
+  std::atomic<float> cpuLoad{0.0f};
+
+  void recordRenderTime(double elapsedMs, double blockMs) {
+    constexpr float kSmoothing = 0.1f;
+    renderCostMs += kSmoothing * ((float)elapsedMs - renderCostMs);
+    if (blockMs > 0.0)
+      cpuLoad.store((float)(renderCostMs / blockMs), std::memory_order_relaxed);
+  }
+
+  MixerStrip() {
+    midiBuffer.ensureSize(kMidiBufferBytes);
+    clearMissedControllers();
+  }
+
+  ~MixerStrip() {
+    editorWindow.reset(); // before the plugin it edits
+    delete plugin.load(std::memory_order_relaxed);
+  }
+
+  /// Message-thread view of the loaded plugin (nullptr if none).
+  juce::AudioPluginInstance *getPlugin() const {
+    auto *slot = plugin.load(std::memory_order_acquire);
+    return slot ? slot->instance.get() : nullptr;
+  }
+
+  /// Re-prepare the loaded plugin. Only while nothing renders (the audio
+  /// device is stopped, or the strip is not yet published).
+  void prepareToPlay(const RenderConfig &newConfig) {
+    config = newConfig;
+    if (auto *slot = plugin.load(std::memory_order_acquire)) {
+      prepareInstance(*slot->instance, config);
+      slot->buffer.setSize(numChannelsFor(*slot->instance),
+                           config.maxBlockSize);
+      slot->sleepAfterSamples = sleepAfterSamplesFor(*slot->instance);
+      slot->mono = slot->instance->getTotalNumOutputChannels() == 1;
     }
   }
 
+  /// Called by whichever thread renders (the offline renderer), between
+  /// blocks.
+  void setNonRealtime(bool isNonRealtime) {
+    if (auto *slot = plugin.load(std::memory_order_acquire))
+      slot->instance->setNonRealtime(isNonRealtime);
+  }
+
+  /// Queue a message for the audio thread. Single producer: the
+  /// TrackerEvents dispatcher thread (MixerModel::routeEvent()). Lock-free;
+  /// drops the message if the queue is full.
   void addDelayedMessage(double triggerTime, const juce::MidiMessage &msg) {
-    std::lock_guard<std::mutex> lock(midiMutex);
-    delayedMessages.push_back({triggerTime, msg});
-  }
-
-  void processBlock(juce::AudioBuffer<float> &audioBuffer, double currentTime) {
-    juce::MidiBuffer midiBuffer;
-    {
-      std::lock_guard<std::mutex> lock(midiMutex);
-      for (auto it = delayedMessages.begin(); it != delayedMessages.end();) {
-        if (currentTime >= it->first) {
-          std::cerr << "[MixerStrip " << id << "] Popped delayed event: len="
-                    << it->second.getRawDataSize()
-                    << ", timeDiff=" << (currentTime - it->first) << "ms"
-                    << std::endl;
-          midiBuffer.addEvent(it->second,
-                              0); // Event fires effectively at sample 0
-          it = delayedMessages.erase(it);
-        } else {
-          ++it;
-        }
-      }
+    if (!midiQueue.push(triggerTime, msg))
+      std::cerr << "[MixerStrip " << id << "] MIDI queue full, dropped event"
+                << std::endl;
+  }
+
+  /// Drop all scheduled MIDI and silence the plugin at the start of the next
+  /// block (transport stop/locate). Same producer as addDelayedMessage();
+  /// the marker travels in-band, so messages queued after it survive.
+  void flush() { midiQueue.pushFlush(); }
+
+  /// Consume the MIDI due this block without running the plugin (the block
+  /// was served from the render cache). Times as for renderBlock().
+  void skipBlock(int numSamples, double blockStart, double timePerSample) {
+    if (!skipped)
+      pluginNotes = heldNotes; // What the plugin was playing when it paused
+    if (midiQueue.drain()) {
+      clearHeldNotes();
+      clearMissedControllers();
+      silenceOnResume = true;
     }
+    popDueMessages(numSamples, blockStart, timePerSample,
+                   [this](const juce::MidiMessage &msg, int) {
+                     rememberMissedController(msg);
+                   });
+    skipped = true;
+  }
 
-    std::lock_guard<std::mutex> lock(processMutex);
-    if (pluginInstance) {
-      int numSamples = audioBuffer.getNumSamples();
+  /// Render this strip's plugin into its slot buffer. Touches nothing shared
+  /// with other strips, so strips can render in parallel; mixInto() sums
+  /// after. Lock-free; the caller holds an RCU read guard across both.
+  ///
+  /// `blockStart` is the trigger-time clock at the block's first sample and
+  /// `timePerSample` its rate (ms per sample in real time, 1 when offline
+  /// export schedules by host sample), so each message lands on its own
+  /// sample. `deadline` (high-resolution ticks) is the mix's deadline for
+  /// the block, passed to a sandboxed plugin.
+  void renderBlock(int numSamples, double blockStart, double timePerSample,
+                   juce::int64 deadline) {
+    renderedSlot = nullptr;
+    renderedSamples = 0;
+    if (bypassed.load(std::memory_order_relaxed)) {
+      // Keep held notes current so un-bypassing resumes like a cached block
+      skipBlock(numSamples, blockStart, timePerSample);
+      asleep.store(false, std::memory_order_relaxed);
+      return;
+    }
 
-      // Safety check just in case tempBuffer isn't sized
-      if (tempBuffer.getNumChannels() > 0 &&
-          tempBuffer.getNumSamples() >= numSamples) {
-        tempBuffer.clear();
-        pluginInstance->processBlock(tempBuffer, midiBuffer);
+    midiBuffer.clear();
+    const bool flushed = midiQueue.drain();
+    if (flushed) {
+      clearHeldNotes();
+      clearMissedControllers();
+    }
+    // A flush consumed while skipped still has to silence the plugin
+    const bool flushing = flushed || silenceOnResume;
+    silenceOnResume = false;
+    if (isAsleep()) {
+      if (!flushing && !skipped &&
+          !midiQueue.hasDue(blockStart + numSamples * timePerSample))
+        return; // Still idle: no MIDI, no tail, nothing to render
+      asleep.store(false, std::memory_order_relaxed);
+      silentSamples = 0;
+    }
 
-        // Mix down (sum) output to the main host buffer
-        int channelsToSum = juce::jmin((int)audioBuffer.getNumChannels(),
-                                       tempBuffer.getNumChannels());
-        for (int i = 0; i < channelsToSum; ++i) {
-          audioBuffer.addFrom(i, 0, tempBuffer, i, 0, numSamples);
-        }
+    if (flushing) {
+      for (int ch = 1; ch <= 16; ++ch) {
+        midiBuffer.addEvent(juce::MidiMessage::allSoundOff(ch), 0);
+        midiBuffer.addEvent(juce::MidiMessage::allNotesOff(ch), 0);
       }
     }
-  }
+    if (skipped) {
+      // Back from cached playback: catch up on controllers, and release
+      // what ended meanwhile. Notes still held carry on in the plugin
+      // rather than attack twice; ones that began in the cached audio are
+      // not restarted mid-note.
+      addMissedControllers();
+      if (!flushing)
+        releaseNotesEndedWhileSkipped();
+    }
+    skipped = false;
 
-  /// Load a plugin from a description. Must be called on the message thread.
-  void loadPlugin(const juce::PluginDescription &desc,
-                  juce::AudioPluginFormatManager &formatManager,
-                  std::function<void(bool)> onComplete = nullptr) {
+    popDueMessages(numSamples, blockStart, timePerSample,
+                   [&](const juce::MidiMessage &msg, int sampleOffset) {
+                     midiBuffer.addEvent(msg, sampleOffset);
+                   });
 
-    formatManager.createPluginInstanceAsync(
-        desc, currentSampleRate, currentBlockSize,
-        [this, desc,
-         onComplete](std::unique_ptr<juce::AudioPluginInstance> instance,
-                     const juce::String &error) {
-          if (!instance) {
-            std::cerr << "[MixerStrip " << id << "] Failed to load "
-                      << desc.name << ": " << error << std::endl;
-            if (onComplete)
-              onComplete(false);
-            return;
-          }
+    renderedSlot = plugin.load(std::memory_order_acquire);
+    if (auto *slot = renderedSlot) {
+      // MixerModel splits blocks to the prepared size, so this always fits
+      jassert(numSamples <= slot->buffer.getNumSamples());
+      if (slot->buffer.getNumChannels() > 0 &&
+          slot->buffer.getNumSamples() >= numSamples) {
+        // View of exactly numSamples, so short blocks keep the plugin in time
+        juce::AudioBuffer<float> block(slot->buffer.getArrayOfWritePointers(),
+                                       slot->buffer.getNumChannels(),
+                                       numSamples);
+        block.clear();
+        if (flushing)
+          slot->instance->reset(); // Cut reverb/release tails too
+        if (slot->sandbox)
+          slot->sandbox->setBlockDeadline(deadline);
+        slot->instance->processBlock(block, midiBuffer);
+        renderedSamples = numSamples;
+        updateSleep(*slot, block);
+      }
+    }
+  }
 
-          // Unload the old UI if valid
-          editorWindow.reset();
+  /// Sum the block produced by the last renderBlock() into the stereo mix
+  /// bus, with gain, pan, mute and solo applied in the same pass: each output
+  /// sample is one multiply-add, so the strip's audio is read exactly once.
+  /// Gain changes ramp across the block to avoid zipper noise.
+  /// `soloActive` is true if any strip in the mix is soloed.
+  void mixInto(juce::AudioBuffer<float> &audioBuffer, bool soloActive) {
+    std::array<float, 2> target = targetGains(soloActive);
+    if (renderedSlot == nullptr) {
+      // Nothing audible to ramp; sends wake from the current gain too
+      rampFrom = target;
+      appliedGains = target;
+      return;
+    }
+    const auto &buffer = renderedSlot->buffer;
+    const int numSamples =
+        juce::jmin(renderedSamples, audioBuffer.getNumSamples());
+    const int outputs = juce::jmin(audioBuffer.getNumChannels(), 2);
+    for (int ch = 0; ch < outputs; ++ch) {
+      int src = renderedSlot->mono
+                    ? 0
+                    : juce::jmin(ch, buffer.getNumChannels() - 1);
+      mixWithGainRamp(audioBuffer.getWritePointer(ch),
+                      buffer.getReadPointer(src), numSamples,
+                      appliedGains[(size_t)ch], target[(size_t)ch]);
+    }
+    rampFrom = appliedGains;
+    appliedGains = target;
+  }
 
-          int maxChannels =
-              juce::jmax(instance->getTotalNumInputChannels(),
-                         instance->getTotalNumOutputChannels(), 2);
+  /// Post-fader send into an effect return bus. Call after mixInto() for the
+  /// same block; follows the same fader ramp, scaled by the send level.
+  void sendInto(juce::AudioBuffer<float> &busBuffer, Send &send) {
+    const float to = juce::Decibels::decibelsToGain(
+        send.gainDb.load(std::memory_order_relaxed));
+    const float from = send.applied;
+    send.applied = to;
+    if (renderedSlot == nullptr)
+      return;
+    const auto &buffer = renderedSlot->buffer;
+    const int numSamples =
+        juce::jmin(renderedSamples, busBuffer.getNumSamples());
+    const int outputs = juce::jmin(busBuffer.getNumChannels(), 2);
+    for (int ch = 0; ch < outputs; ++ch) {
+      int src = renderedSlot->mono
+                    ? 0
+                    : juce::jmin(ch, buffer.getNumChannels() - 1);
+      mixWithGainRamp(busBuffer.getWritePointer(ch), buffer.getReadPointer(src),
+                      numSamples, rampFrom[(size_t)ch] * from,
+                      appliedGains[(size_t)ch] * to);
+    }
+  }
 
-          instance->prepareToPlay(currentSampleRate, currentBlockSize);
+  /// Make a freshly created plugin live: prepared for the strip's config,
+  /// `initialState` restored unless the loader already did (a sandbox
+  /// restores it inside its worker), then swapped in. Message thread only;
+  /// plugins are created by MixerModel::loadStripPlugin().
+  void installPlugin(std::unique_ptr<juce::AudioPluginInstance> instance,
+                     const juce::PluginDescription &desc,
+                     const juce::MemoryBlock &initialState,
+                     bool restoredByLoader) {
+    loadTicket = 0;
 
-          // We must safely swap the pointer inside the audio lock, but we
-          // DO NOT want to destroy the old plugin inside the lock.
-          std::unique_ptr<juce::AudioPluginInstance> oldPlugin;
-          {
-            std::lock_guard<std::mutex> lock(processMutex);
-            tempBuffer.setSize(maxChannels, currentBlockSize);
+    // Unload the old UI if valid
+    editorWindow.reset();
 
-            oldPlugin = std::move(pluginInstance);
-            pluginInstance = std::move(instance);
-            pluginUid = desc.uniqueId;
-          }
-          // oldPlugin is safely destroyed here, off the audio thread lock.
-          // Editor is NOT opened here — user opens it via showEditor().
+    // Build the complete slot off to the side, then publish it
+    auto slot = std::make_unique<PluginSlot>();
+    prepareInstance(*instance, config);
+    if (!restoredByLoader && initialState.getSize() > 0)
+      instance->setStateInformation(initialState.getData(),
+                                    (int)initialState.getSize());
+    slot->buffer.setSize(numChannelsFor(*instance), config.maxBlockSize);
+    slot->sleepAfterSamples = sleepAfterSamplesFor(*instance);
+    slot->mono = instance->getTotalNumOutputChannels() == 1;
+    slot->sandbox = dynamic_cast<SandboxedPluginInstance *>(instance.get());
+    slot->instance = std::move(instance);
+    if (mixGeneration)
+      slot->instance->addListener(mixGeneration);
+    pluginUid = desc.uniqueId;
+    retire(plugin.exchange(slot.release(), std::memory_order_acq_rel));
+    // Editor is NOT opened here — user opens it via showEditor().
 
-          std::cerr << "[MixerStrip " << id << "] Loaded (Async): " << desc.name
-                    << std::endl;
-          if (onComplete)
-            onComplete(true);
-        });
+    std::cerr << "[MixerStrip " << id << "] Loaded (Async): " << desc.name
+              << (restoredByLoader ? " (sandboxed)" : "") << std::endl;
   }
 
   /// Unload the plugin and close editor.
   void unloadPlugin() {
+    loadTicket = 0;
     editorWindow.reset();
-
-    std::lock_guard<std::mutex> lock(processMutex);
-    if (pluginInstance) {
-      pluginInstance->releaseResources();
-      pluginInstance.reset();
-    }
+    retire(plugin.exchange(nullptr, std::memory_order_acq_rel));
     pluginUid = 0;
   }
 
   /// Show the editor window (create if needed).
   void showEditor() {
-    if (!pluginInstance)
+    auto *instance = getPlugin();
+    if (!instance)
+      return;
+    if (auto *remote = dynamic_cast<SandboxedPluginInstance *>(instance)) {
+      remote->showRemoteEditor(); // Opens in the worker process
       return;
+    }
     if (editorWindow) {
       editorWindow->setVisible(true);
       editorWindow->toFront(true);
-    } else if (auto *editor = pluginInstance->createEditor()) {
+    } else if (auto *editor = instance->createEditor()) {
       editorWindow = std::make_unique<PluginEditorWindow>(name, editor);
     }
   }
@@ -171,9 +374,205 @@ struct MixerStrip {
     obj->setProperty("inputPort", inputPort);
     obj->setProperty("inputChannel", inputChannel);
     obj->setProperty("pluginUid", pluginUid);
-    obj->setProperty("hasPlugin", pluginInstance != nullptr);
+    obj->setProperty("hasPlugin", getPlugin() != nullptr);
+    obj->setProperty("sandboxed", sandboxed);
+    if (auto *remote = dynamic_cast<SandboxedPluginInstance *>(getPlugin())) {
+      obj->setProperty("sandboxRunning", remote->isWorkerRunning());
+      obj->setProperty("sandboxRestarts", remote->getNumRestarts());
+      obj->setProperty("sandboxMissed",
+                       (juce::int64)remote->getNumMissedBlocks());
+      obj->setProperty("sandboxDropped",
+                       (juce::int64)remote->getNumDroppedEvents());
+    }
+    obj->setProperty("bypassed", bypassed.load(std::memory_order_relaxed));
+    obj->setProperty("gainDb", gainDb.load(std::memory_order_relaxed));
+    obj->setProperty("pan", pan.load(std::memory_order_relaxed));
+    obj->setProperty("muted", muted.load(std::memory_order_relaxed));
+    obj->setProperty("soloed", soloed.load(std::memory_order_relaxed));
+    auto *sendsObj = new juce::DynamicObject();
+    for (auto &send : sends)
+      sendsObj->setProperty(send->busId,
+                            send->gainDb.load(std::memory_order_relaxed));
+    obj->setProperty("sends", juce::var(sendsObj));
+    obj->setProperty("cpu", cpuLoad.load(std::memory_order_relaxed));
     return juce::var(obj);
   }
+
+private:
+  static constexpr int kMidiBufferBytes = 16 * 1024;
+
+  // Output peak below this (about -90 dBFS) counts as silence
+  static constexpr float kSilenceThreshold = 3.0e-5f;
+  // Silence required before sleeping even if the plugin reports no tail
+  static constexpr double kMinSleepSeconds = 0.5;
+  // Plugins reporting a longer (or infinite) tail never auto-sleep
+  static constexpr double kMaxTailSeconds = 60.0;
+
+  static int numChannelsFor(const juce::AudioPluginInstance &instance) {
+    return juce::jmax(instance.getTotalNumInputChannels(),
+                      instance.getTotalNumOutputChannels(), 2);
+  }
+
+  /// Per-channel gains for the current fader settings. Constant-power pan,
+  /// normalised so the centre is unity (+3 dB fully left or right).
+  std::array<float, 2> targetGains(bool soloActive) const {
+    if (muted.load(std::memory_order_relaxed) ||
+        (soloActive && !soloed.load(std::memory_order_relaxed)))
+      return {0.0f, 0.0f};
+    const float gain =
+        juce::Decibels::decibelsToGain(gainDb.load(std::memory_order_relaxed));
+    const float angle =
+        (juce::jlimit(-1.0f, 1.0f, pan.load(std::memory_order_relaxed)) +
+         1.0f) *
+        juce::MathConstants<float>::pi * 0.25f;
+    return {gain * juce::MathConstants<float>::sqrt2 * std::cos(angle),
+            gain * juce::MathConstants<float>::sqrt2 * std::sin(angle)};
+  }
+
+  int64_t sleepAfterSamplesFor(juce::AudioPluginInstance &instance) const {
+    double tail = instance.getTailLengthSeconds();
+    if (!std::isfinite(tail) || tail > kMaxTailSeconds)
+      return -1;
+    return (int64_t)(juce::jmax(tail, kMinSleepSeconds) * config.sampleRate);
+  }
+
+  /// Count silent output after the last note and fall asleep once it
+  /// exceeds the plugin's tail. Peak detection uses JUCE's vectorised
+  /// min/max scan.
+  void updateSleep(const PluginSlot &slot,
+                   const juce::AudioBuffer<float> &out) {
+    if (numHeldNotes > 0 || slot.sleepAfterSamples < 0 ||
+        out.getMagnitude(0, out.getNumSamples()) > kSilenceThreshold) {
+      silentSamples = 0;
+      return;
+    }
+    silentSamples += out.getNumSamples();
+    if (silentSamples >= slot.sleepAfterSamples)
+      asleep.store(true, std::memory_order_relaxed);
+  }
+
+  /// Wait out any reader of `old`, then free it. The strip sounds
+  /// different from here on. Message thread only.
+  void retire(PluginSlot *old) {
+    if (mixGeneration)
+      mixGeneration->bump();
+    if (old == nullptr)
+      return;
+    if (mixGeneration)
+      old->instance->removeListener(mixGeneration);
+    if (rcu)
+      rcu->synchronize();
+    old->instance->releaseResources();
+    delete old;
+  }
+
+  /// Pop every message due in this block, in time order, with its sample
+  /// offset in the block, keeping heldNotes up to date. Late messages land
+  /// on sample 0.
+  template <typename Fn>
+  void popDueMessages(int numSamples, double blockStart, double timePerSample,
+                      Fn &&fn) {
+    const double blockEnd = blockStart + numSamples * timePerSample;
+    midiQueue.popDue(blockEnd, [&](const ScheduledMidi &item) {
+      auto msg = item.toMidiMessage();
+      if (msg.isNoteOnOrOff()) {
+        auto &held = heldNotes[(size_t)(msg.getChannel() - 1)]
+                              [(size_t)msg.getNoteNumber()];
+        const juce::uint8 vel = msg.isNoteOn() ? msg.getVelocity() : 0;
+        numHeldNotes += (vel != 0) - (held != 0);
+        held = vel;
+      }
+      int offset = (int)((item.time - blockStart) / timePerSample);
+      fn(msg, juce::jlimit(0, juce::jmax(0, numSamples - 1), offset));
+    });
+  }
+
+  /// Note-offs for notes the plugin was left holding when it was skipped
+  /// that have since ended.
+  void releaseNotesEndedWhileSkipped() {
+    for (int ch = 0; ch < 16; ++ch)
+      for (int note = 0; note < 128; ++note)
+        if (pluginNotes[(size_t)ch][(size_t)note] != 0 &&
+            heldNotes[(size_t)ch][(size_t)note] == 0)
+          midiBuffer.addEvent(juce::MidiMessage::noteOff(ch + 1, note), 0);
+  }
+
+  void clearHeldNotes() {
+    for (auto &channel : heldNotes)
+      channel.fill(0);
+    numHeldNotes = 0;
+  }
+
+  /// Latest controller, pitch bend and pressure values consumed while the
+  /// strip was skipped, so the plugin can catch up when rendering resumes.
+  void rememberMissedController(const juce::MidiMessage &msg) {
+    const auto ch = (size_t)(msg.getChannel() - 1);
+    if (msg.isController())
+      missedCC[ch][(size_t)msg.getControllerNumber()] =
+          (juce::int16)msg.getControllerValue();
+    else if (msg.isPitchWheel())
+      missedPitchBend[ch] = (juce::int16)msg.getPitchWheelValue();
+    else if (msg.isChannelPressure())
+      missedPressure[ch] = (juce::int16)msg.getChannelPressureValue();
+    else
+      return;
+    missedAny = true;
+  }
+
+  void addMissedControllers() {
+    if (!missedAny)
+      return;
+    for (int ch = 0; ch < 16; ++ch) {
+      for (int cc = 0; cc < 128; ++cc)
+        if (auto v = missedCC[(size_t)ch][(size_t)cc]; v >= 0)
+          midiBuffer.addEvent(juce::MidiMessage::controllerEvent(ch + 1, cc, v),
+                              0);
+      if (auto v = missedPitchBend[(size_t)ch]; v >= 0)
+        midiBuffer.addEvent(juce::MidiMessage::pitchWheel(ch + 1, v), 0);
+      if (auto v = missedPressure[(size_t)ch]; v >= 0)
+        midiBuffer.addEvent(juce::MidiMessage::channelPressureChange(ch + 1, v),
+                            0);
+    }
+    clearMissedControllers();
+  }
+
+  void clearMissedControllers() {
+    for (auto &channel : missedCC)
+      channel.fill(-1);
+    missedPitchBend.fill(-1);
+    missedPressure.fill(-1);
+    missedAny = false;
+  }
+
+  std::atomic<PluginSlot *> plugin{nullptr};
+
+  // TrackerEvents dispatcher thread -> audio thread
+  MidiScheduleQueue midiQueue;
+
+  // Audio thread only
+  juce::MidiBuffer midiBuffer;
+  PluginSlot *renderedSlot = nullptr;
+  int renderedSamples = 0;
+  std::array<float, 2> appliedGains{1.0f, 1.0f};
+  std::array<float, 2> rampFrom{1.0f, 1.0f}; // start of the last block's ramp
+
+  // Velocity of each sounding note per channel (0 = off), so a strip
+  // skipped for cached blocks can re-sync its voices on resume.
+  std::array<std::array<juce::uint8, 128>, 16> heldNotes{};
+  int numHeldNotes = 0;
+  bool skipped = false;
+  // heldNotes as of the first skipped block: what the plugin still holds
+  std::array<std::array<juce::uint8, 128>, 16> pluginNotes{};
+  bool silenceOnResume = false; // flushed while skipped
+
+  std::atomic<bool> asleep{false};
+  int64_t silentSamples = 0;
+
+  // -1 = unchanged while skipped
+  std::array<std::array<juce::int16, 128>, 16> missedCC;
+  std::array<juce::int16, 16> missedPitchBend;
+  std::array<juce::int16, 16> missedPressure;
+  bool missedAny = false;
 };
 
 } // namespace fiddle
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "ActiveNoteTable.h"
 #include "ExpressionMap.h"
+#include "TrackedNote.h"
+#include "TrackerEventQueue.h"
+#include "TransportClock.h"
 #include "midi_event.pb.h"
 #include <algorithm> // Added for std::find
 #include <array>
@@ -24,249 +28,372 @@ inline void noteOffLog(const std::string &msg) {
 
 /**
  * Tracks active MIDI notes and manages their lifecycle.
+ *
+ * Notes are TrackedNotes: plain data, so tracking allocates nothing per
+ * note. toProto() builds the fiddle::Note protobuf for the UI. Per-note CC
+ * automation stays in the channel CC logs (it feeds endVelocity); nothing
+ * reads it as cc_automation lanes yet, so no protobuf form is built.
+ *
+ * The tracker is a single-threaded actor. Its state is owned by the thread
+ * that calls processEvent() (the MIDI server thread) and is never locked.
+ * What it learns (notes starting, ending and being updated, and every MIDI
+ * event after its bookkeeping) goes out through getEvents(), a lock-free
+ * queue drained by a TrackerEventDispatcher. Scripts, mixer routing and the
+ * UI run there, so their cost never holds up tracking.
  */
 class NoteStreamTracker {
 public:
-  struct Callbacks {
-    std::function<void(const fiddle::Note &)> onNoteStarted;
-    std::function<void(const fiddle::Note &)> onNoteEnded;
-    std::function<void(const fiddle::Note &)> onNoteUpdated;
-    std::function<void(const fiddle::MidiEvent &, uint64_t absoluteSamples,
-                       int oldCCVal)>
-        onMidiEvent;
-  };
-
-  std::function<void(const juce::String &)> uiLogger;
-
   NoteStreamTracker() {
     for (auto &chan : currentCCs)
       chan.fill(0);
+    for (auto &dirty : ccDirty)
+      dirty.fill(0);
   }
 
-  void setCallbacks(Callbacks cbs) { callbacks = std::move(cbs); }
-
-  void setExpressionMap(const ExpressionMap *map) { expMap = map; }
+  /// Outbound events, in the order they happened.
+  TrackerEventQueue &getEvents() { return events; }
 
-  void resetSessionStartTime() {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    sessionStartTime = -1.0;
-    activeNotes.clear();
-    if (uiLogger)
-      uiLogger("<b>[Tracker]</b> Session reset via Transport Start");
+  void setExpressionMap(const ExpressionMap *map) {
+    expMap = map;
+    if (map != nullptr &&
+        (int)map->getDimensions().size() > TrackedNote::kMaxDimensions)
+      std::cerr << "[NoteStreamTracker] Expression map has "
+                << map->getDimensions().size() << " dimensions; notes track "
+                << "the first " << TrackedNote::kMaxDimensions << std::endl;
   }
 
-  void processEvent(const fiddle::MidiEvent &event) {
-    if (uiLogger)
-      uiLogger("[Tracker] processEvent: Case=" +
-               juce::String((int)event.event_case()));
-
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    std::cerr << "[NoteStreamTracker] processEvent: Case="
-              << (int)event.event_case() << " Ch=" << event.channel()
-              << std::endl;
+  /// The session clock, driven by the host positions on the events this
+  /// tracker sees.
+  TransportClock &getClock() { return clock; }
+  const TransportClock &getClock() const { return clock; }
 
-    uint64_t sessionTimestamp = getSessionSamples();
+  /// Tracker thread.
+  void processEvent(const fiddle::MidiEvent &event) {
+    if (event.has_host_sample_position() && !event.has_transport())
+      clock.sync(event.host_sample_position());
     uint64_t absoluteSamples =
         event.has_host_sample_position()
             ? event.host_sample_position()
-            : (sessionTimestamp + event.timestamp_samples());
+            : (clock.now() + event.timestamp_samples());
 
     if (event.has_note_on()) {
       int vel = event.note_on().velocity();
-      if (uiLogger)
-        uiLogger("[Tracker] NoteOn: Note=" +
-                 juce::String(event.note_on().note_number()) +
-                 " Vel=" + juce::String(vel));
-
       if (vel > 0) {
         handleNoteOn(event, absoluteSamples);
       } else {
         handleNoteOff(event, absoluteSamples);
       }
-      if (callbacks.onMidiEvent)
-        callbacks.onMidiEvent(event, absoluteSamples, -1);
+      emitMidi(event, absoluteSamples, -1);
     } else if (event.has_note_off()) {
-      if (uiLogger)
-        uiLogger("[Tracker] NoteOff: Note=" +
-                 juce::String(event.note_off().note_number()));
       handleNoteOff(event, absoluteSamples);
-      if (callbacks.onMidiEvent)
-        callbacks.onMidiEvent(event, absoluteSamples, -1);
+      emitMidi(event, absoluteSamples, -1);
     } else if (event.has_cc()) {
       uint32_t chan = event.channel();
       uint32_t ccNum = event.cc().controller_number();
       uint8_t newVal = (uint8_t)event.cc().controller_value();
+      // CC state is per port and channel: port 3 channel 5 is its own
+      // instrument, not port 1 channel 5. Controller numbers past 127
+      // aren't CCs any row could hold, so they're dropped.
+      const int channel = ActiveNoteTable::channelIndex(event.port(), chan);
 
-      if (chan < 16) {
-        uint8_t oldVal = currentCCs[chan][ccNum % 128];
-        currentCCs[chan][ccNum % 128] = newVal;
+      if (channel >= 0 && ccNum < 128) {
+        const size_t cc = ccNum;
+        uint8_t oldVal = currentCCs[(size_t)channel][cc];
+        currentCCs[(size_t)channel][cc] = newVal;
 
         if (oldVal != newVal) {
-          if (uiLogger) {
-            uiLogger("<b>[CC]</b> Ch " + juce::String(chan + 1) + " | CC " +
-                     juce::String(ccNum) + " -> " + juce::String(newVal));
-          }
+          ccDirty[(size_t)channel][cc / 64] |= uint64_t(1) << (cc % 64);
 
-          // Append CC change to automation envelope of ALL active notes
-          // on this channel. This captures the full CC history per-note
-          // for later playback.
-          if (ccNum < 128) {
-            uint64_t currentSamples =
-                sessionTimestamp + event.timestamp_samples();
-            for (auto &note : activeNotes) {
-              if (note.port() == event.port() && note.channel() == chan) {
-                auto &lane = (*note.mutable_cc_automation())[ccNum];
-                auto *pt = lane.add_points();
-                uint64_t offset = (currentSamples > note.start_sample())
-                                      ? (currentSamples - note.start_sample())
-                                      : 0;
-                pt->set_offset_samples(offset);
-                pt->set_value(newVal);
-              }
-            }
-          }
+          // Record the change once in the channel's CC log. This captures
+          // the full CC history of every note sounding on the channel, for
+          // later playback, without touching the notes themselves.
+          uint64_t currentSamples = absoluteSamples;
+          uint32_t latest = activeNotes.newestOnChannel(channel);
+          if (latest != ActiveNoteTable::kNone)
+            ccLogs[(size_t)channel].changes.push_back(
+                {currentSamples, (uint8_t)ccNum, newVal});
 
           // Expression map enrichment: update notation dimensions/techniques
           // on the most recently started note (30ms jitter window).
-          {
-            uint64_t currentSamples =
-                sessionTimestamp + event.timestamp_samples();
-            for (int i = (int)activeNotes.size() - 1; i >= 0; --i) {
-              auto &note = activeNotes[i];
-              if (note.port() == event.port() && note.channel() == chan) {
-                uint64_t age = (currentSamples > note.start_sample())
-                                   ? (currentSamples - note.start_sample())
-                                   : 0;
-
-                if (age < 1323) { // 30ms window
-                  if (enrichNoteWithCC(note, (int)ccNum, (int)newVal)) {
-                    if (callbacks.onNoteUpdated)
-                      callbacks.onNoteUpdated(note);
-                  }
-                }
-                break; // Only the latest one
-              }
+          if (latest != ActiveNoteTable::kNone) {
+            auto &note = activeNotes.note(latest);
+            uint64_t age = (currentSamples > note.startSample)
+                               ? (currentSamples - note.startSample)
+                               : 0;
+
+            if (age < clock.samplesFor(0.03)) { // 30ms window
+              if (enrichNoteWithCC(note, (int)ccNum, (int)newVal))
+                emitNote(TrackerEvent::Type::NoteUpdated, note);
             }
           }
 
-          if (callbacks.onMidiEvent)
-            callbacks.onMidiEvent(event, absoluteSamples, (int)oldVal);
+          emitMidi(event, absoluteSamples, (int)oldVal);
         }
       }
     } else if (event.has_transport()) {
-      if (event.transport().type() ==
-          fiddle::MidiEvent_TransportEvent_Type_START) {
-        resetSessionStartTime();
-        if (callbacks.onMidiEvent)
-          callbacks.onMidiEvent(event, 0, -1);
+      const auto &transport = event.transport();
+      const uint64_t position = transport.has_host_sample_position()
+                                    ? transport.host_sample_position()
+                                : event.has_host_sample_position()
+                                    ? event.host_sample_position()
+                                    : clock.now();
+      switch (transport.type()) {
+      case fiddle::MidiEvent_TransportEvent_Type_START:
+      case fiddle::MidiEvent_TransportEvent_Type_LOCATE:
+        clock.locate(position);
+        clearNotes();
+        break;
+      case fiddle::MidiEvent_TransportEvent_Type_STOP:
+        // Notes still sounding at stop never get a note-off
+        clock.stop(position);
+        clearNotes();
+        break;
+      default:
+        break;
       }
+      emitMidi(event, 0, -1);
     } else {
       // Forward all other events (ProgramChange, ContextUpdate, PitchBend,
       // etc.)
-      if (callbacks.onMidiEvent)
-        callbacks.onMidiEvent(event, absoluteSamples, -1);
+      emitMidi(event, absoluteSamples, -1);
     }
   }
 
-  std::vector<fiddle::Note> getActiveNotes() const {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    return activeNotes;
+  /// Visit the sounding notes. Tracker thread.
+  template <typename Fn> void forEachActiveNote(Fn &&fn) const {
+    activeNotes.forEach(fn);
   }
 
-  uint64_t getSessionSamples() const {
-    double now = juce::Time::getMillisecondCounterHiRes();
-    if (sessionStartTime < 0) {
-      sessionStartTime = now;
+  /// Tracker thread.
+  int getNumActiveNotes() const { return activeNotes.size(); }
+
+  /// The protobuf form of a note, for the UI: identity, timing, dynamics
+  /// and notation. Any thread.
+  static fiddle::Note toProto(const TrackedNote &n, const ExpressionMap *map) {
+    fiddle::Note note;
+    note.set_id(n.id);
+    note.set_note_number(n.noteNumber);
+    note.set_channel(n.channel);
+    note.set_port(n.port);
+    note.set_start_velocity(n.startVelocity);
+    note.set_start_sample(n.startSample);
+    note.set_duration_samples(n.durationSamples);
+    note.set_dynamics_mode(n.ccDynamics ? fiddle::Note::CC
+                                        : fiddle::Note::VELOCITY);
+    if (map == nullptr)
+      return note;
+    const auto &dims = map->getDimensions();
+    for (int i = 0; i < (int)dims.size(); ++i) {
+      if (!n.hasDimension(i))
+        continue;
+      const auto &dim = dims[(size_t)i];
+      const int val = n.dimensionValues[(size_t)i];
+      const auto name = dim.name.toStdString();
+      (*note.mutable_notation_dimensions())[name] = (float)val;
+      auto techIt = dim.techniques.find(val);
+      if (techIt != dim.techniques.end())
+        (*note.mutable_notation_techniques())[name] =
+            techIt->second.toStdString();
+      (*note.mutable_notation_is_default())[name] =
+          std::find(dim.defaultValues.begin(), dim.defaultValues.end(), val) !=
+          dim.defaultValues.end();
     }
-    return (uint64_t)((now - sessionStartTime) * 44.1);
+    return note;
   }
 
+  /// Any thread: the current position on the session clock.
+  uint64_t getSessionSamples() const { return clock.now(); }
+
 private:
-  mutable double sessionStartTime = -1.0;
-  mutable std::recursive_mutex mutex;
-  Callbacks callbacks;
+  TransportClock clock;
   const ExpressionMap *expMap = nullptr;
+  TrackerEventQueue events;
+
+  void emitNote(TrackerEvent::Type type, const TrackedNote &note) {
+    auto &e = events.prepare();
+    e.type = type;
+    e.note = note;
+    e.arrivalMs = juce::Time::getMillisecondCounterHiRes();
+    events.push();
+  }
+
+  void emitMidi(const fiddle::MidiEvent &event, uint64_t absoluteSamples,
+                int oldCCValue) {
+    auto &e = events.prepare();
+    e.type = TrackerEvent::Type::Midi;
+    e.midi.CopyFrom(event);
+    e.absoluteSamples = absoluteSamples;
+    e.oldCCValue = oldCCValue;
+    e.arrivalMs = juce::Time::getMillisecondCounterHiRes();
+    events.push();
+  }
+
+  /// CC changes on one channel while it has notes sounding, shared by all
+  /// of them, and the CC values each note started with. Cleared (keeping
+  /// capacity) when the channel's last note ends, and compacted as notes end
+  /// under a legato line that never lets the channel go silent.
+  struct CcLog {
+    std::vector<CcChange> changes;
+    std::vector<std::array<uint8_t, 128>> seeds;
+
+    void clear() {
+      changes.clear();
+      seeds.clear();
+    }
+  };
+
+  ActiveNoteTable activeNotes;
+  std::array<CcLog, ActiveNoteTable::kNumChannels> ccLogs;
 
-  std::vector<fiddle::Note> activeNotes;
-  std::array<std::array<uint8_t, 128>, 16> currentCCs;
+  // Current CC values per logical channel (port × channel), one 128-byte
+  // row each, and a bitmap per row of the CCs that changed since the row
+  // was last snapshotted into its CC log as a note seed.
+  std::array<std::array<uint8_t, 128>, ActiveNoteTable::kNumChannels>
+      currentCCs;
+  std::array<std::array<uint64_t, 2>, ActiveNoteTable::kNumChannels> ccDirty;
   uint64_t nextNoteId = 1;
-  bool enrichNoteWithCC(fiddle::Note &note, int ccNum, int val) {
+
+  void clearNotes() {
+    activeNotes.clear();
+    for (auto &log : ccLogs)
+      log.clear();
+  }
+
+  /// Seed snapshot for a note starting on `channel` now. Notes starting
+  /// with no CC change in between (a chord, a run of repeated notes) share
+  /// one; otherwise only the CCs flagged dirty are updated from the last.
+  uint32_t seedFor(int channel) {
+    auto &log = ccLogs[(size_t)channel];
+    auto &dirty = ccDirty[(size_t)channel];
+    const auto &values = currentCCs[(size_t)channel];
+    if (log.seeds.empty()) {
+      log.seeds.push_back(values); // First note since the channel was silent
+    } else if ((dirty[0] | dirty[1]) != 0) {
+      auto seed = log.seeds.back();
+      for (size_t word = 0; word < 2; ++word)
+        for (uint64_t bits = dirty[word]; bits != 0; bits &= bits - 1) {
+          const uint64_t lowest = bits & (~bits + 1);
+          const size_t cc =
+              word * 64 + (size_t)juce::countNumberOfBits(lowest - 1);
+          seed[cc] = values[cc];
+        }
+      log.seeds.push_back(seed);
+    }
+    dirty.fill(0);
+    return (uint32_t)log.seeds.size() - 1;
+  }
+
+  /// Drop the log entries no sounding note on `channel` references any
+  /// more, and rebase the notes' indices. Only once at least half the log
+  /// is dead, so the move is amortised over the changes that filled it and
+  /// the log stays within twice what the sounding notes span.
+  void compactCcLog(int channel) {
+    auto &log = ccLogs[(size_t)channel];
+    uint32_t firstChange = (uint32_t)log.changes.size();
+    uint32_t firstSeed = (uint32_t)log.seeds.size();
+    activeNotes.forEachOnChannel(channel, [&](const TrackedNote &n) {
+      firstChange = std::min(firstChange, n.automationBegin);
+      firstSeed = std::min(firstSeed, n.seed);
+    });
+    const bool changesDead =
+        firstChange > 0 && firstChange * 2 >= log.changes.size();
+    const bool seedsDead = firstSeed > 0 && firstSeed * 2 >= log.seeds.size();
+    if (!changesDead && !seedsDead)
+      return;
+    if (changesDead)
+      log.changes.erase(log.changes.begin(),
+                        log.changes.begin() + firstChange);
+    if (seedsDead)
+      log.seeds.erase(log.seeds.begin(), log.seeds.begin() + firstSeed);
+    activeNotes.forEachOnChannel(channel, [&](TrackedNote &n) {
+      if (changesDead)
+        n.automationBegin -= firstChange;
+      if (seedsDead)
+        n.seed -= firstSeed;
+    });
+  }
+
+  /// End of a note's automation range: fixed when it ends, else the log's.
+  uint32_t automationEndFor(const TrackedNote &n) const {
+    if (n.automationEnd != kAutomationOpen)
+      return n.automationEnd;
+    const int channel = ActiveNoteTable::channelIndex(n.port, n.channel);
+    return channel < 0 ? n.automationBegin
+                       : (uint32_t)ccLogs[(size_t)channel].changes.size();
+  }
+  static constexpr uint32_t kAutomationOpen = 0xffffffffu;
+
+  bool enrichNoteWithCC(TrackedNote &note, int ccNum, int val) {
     if (expMap == nullptr)
       return false;
 
-    const auto *dim = expMap->getDimensionForCC(ccNum);
-    if (dim != nullptr) {
-      (*note.mutable_notation_dimensions())[dim->name.toStdString()] =
-          (float)val;
-
-      auto techIt = dim->techniques.find(val);
-      if (techIt != dim->techniques.end()) {
-        (*note.mutable_notation_techniques())[dim->name.toStdString()] =
-            techIt->second.toStdString();
-      } else {
-        note.mutable_notation_techniques()->erase(dim->name.toStdString());
-      }
+    const int index = expMap->getDimensionIndexForCC(ccNum);
+    if (index < 0 || index >= TrackedNote::kMaxDimensions)
+      return false;
+    note.setDimension(index, (uint8_t)val);
+    return true;
+  }
 
-      bool isDefault =
-          (std::find(dim->defaultValues.begin(), dim->defaultValues.end(),
-                     val) != dim->defaultValues.end());
-      (*note.mutable_notation_is_default())[dim->name.toStdString()] =
-          isDefault;
-      return true;
-    }
-    return false;
+  /// The note's dynamics now: its last CC1 value for CC-dynamics notes that
+  /// have one (as the CC1 automation lane would show), else its velocity.
+  uint8_t currentDynamics(const TrackedNote &n) const {
+    if (!n.ccDynamics)
+      return n.startVelocity;
+    const int channel = ActiveNoteTable::channelIndex(n.port, n.channel);
+    if (channel < 0)
+      return n.startVelocity;
+    const auto &log = ccLogs[(size_t)channel];
+    const size_t end =
+        std::min<size_t>(automationEndFor(n), log.changes.size());
+    for (size_t i = end; i-- > n.automationBegin;)
+      if (log.changes[i].controller == 1)
+        return log.changes[i].value;
+    if (n.seed < log.seeds.size() && log.seeds[n.seed][1] != 0)
+      return log.seeds[n.seed][1];
+    return n.startVelocity;
   }
 
   void handleNoteOn(const fiddle::MidiEvent &event, uint64_t absoluteSamples) {
     const auto &noteOn = event.note_on();
     uint32_t chan = event.channel();
-
-    fiddle::Note note;
-    note.set_id(nextNoteId++);
-    note.set_note_number(noteOn.note_number());
-    note.set_channel(chan);
-    note.set_port(event.port());
-    note.set_start_velocity(noteOn.velocity());
-    note.set_start_sample(absoluteSamples);
+    const int channel = ActiveNoteTable::channelIndex(event.port(), chan);
+    if (channel < 0)
+      return; // Beyond the plugin's 16 ports; nothing routes there
+
+    TrackedNote note;
+    note.id = nextNoteId++;
+    note.noteNumber = (uint8_t)(noteOn.note_number() & 0x7f);
+    note.channel = (uint8_t)juce::jlimit(1, 16, (int)chan);
+    note.port = event.port();
+    note.startVelocity = (uint8_t)juce::jmin(127u, noteOn.velocity());
+    note.startSample = absoluteSamples;
 
     // Enrich note with notation dimensions from ExpressionMap
-    if (expMap != nullptr && chan < 16) {
+    const auto &ccs = currentCCs[(size_t)channel];
+    if (expMap != nullptr) {
       for (const auto &dim : expMap->getDimensions()) {
         if (dim.ccNumber >= 0 && dim.ccNumber < 128) {
-          uint8_t val = currentCCs[chan][dim.ccNumber % 128];
+          uint8_t val = ccs[(size_t)dim.ccNumber];
           enrichNoteWithCC(note, dim.ccNumber, val);
         }
       }
 
       // Set dynamics mode based on current CC102 (base switch) value
-      uint8_t cc102Val = currentCCs[chan][102];
-      if (expMap->dynamicsUsesCC1((int)cc102Val)) {
-        note.set_dynamics_mode(fiddle::Note::CC);
-      } else {
-        note.set_dynamics_mode(fiddle::Note::VELOCITY);
-      }
+      uint8_t cc102Val = ccs[102];
+      note.ccDynamics = expMap->dynamicsUsesCC1((int)cc102Val);
     }
 
-    // Seed all CC automation lanes with current values at offset 0
-    if (chan < 16) {
-      for (int cc = 0; cc < 128; ++cc) {
-        uint8_t val = currentCCs[chan][cc];
-        if (val != 0) { // Only seed non-zero CCs to keep notes compact
-          auto &lane = (*note.mutable_cc_automation())[cc];
-          auto *pt = lane.add_points();
-          pt->set_offset_samples(0);
-          pt->set_value(val);
-        }
-      }
-    }
+    // Automation starts from the channel's current CC values; later changes
+    // land in the channel's log
+    note.seed = seedFor(channel);
+    note.automationBegin = (uint32_t)ccLogs[(size_t)channel].changes.size();
+    note.automationEnd = kAutomationOpen;
+    note.endVelocity = currentDynamics(note);
 
-    activeNotes.push_back(note);
+    const uint32_t slot =
+        activeNotes.add(channel, (int)note.noteNumber, note);
 
-    if (callbacks.onNoteStarted) {
-      std::cerr << "[NoteStreamTracker] Triggering onNoteStarted: ID="
-                << note.id() << std::endl;
-      callbacks.onNoteStarted(note);
-    }
+    emitNote(TrackerEvent::Type::NoteStarted, activeNotes.note(slot));
   }
 
   void handleNoteOff(const fiddle::MidiEvent &event, uint64_t absoluteSamples) {
@@ -281,44 +408,46 @@ private:
     uint32_t chan = event.channel();
     uint32_t port = event.port();
 
-    noteOffLog("[NoteOff] Looking for port=" + std::to_string(port) + " ch=" +
-               std::to_string(chan) + " note=" + std::to_string(noteNum) +
-               " endSample=" + std::to_string(absoluteSamples) +
-               " activeNotes=" + std::to_string(activeNotes.size()));
-
-    for (auto it = activeNotes.begin(); it != activeNotes.end(); ++it) {
-      if (it->port() == port && it->channel() == chan &&
-          it->note_number() == noteNum) {
-        uint64_t endSample = absoluteSamples;
-        if (endSample < it->start_sample()) {
-          noteOffLog(
-              "[NoteOff] SKIPPED: endSample=" + std::to_string(endSample) +
-              " < startSample=" + std::to_string(it->start_sample()));
-          continue;
-        }
-
-        it->set_duration_samples(endSample - it->start_sample());
-
-        if (callbacks.onNoteEnded) {
-          noteOffLog("[NoteOff] MATCHED ID=" + std::to_string(it->id()));
-          callbacks.onNoteEnded(*it);
-        }
-        activeNotes.erase(it);
-        return;
+    // Oldest note on this pitch first, so overlapping repeats end in order
+    const int channel = ActiveNoteTable::channelIndex(port, chan);
+    uint32_t slot = channel >= 0 && noteNum < 128
+                        ? activeNotes.firstOnPitch(channel, (int)noteNum)
+                        : ActiveNoteTable::kNone;
+    for (; slot != ActiveNoteTable::kNone;
+         slot = activeNotes.nextOnPitch(slot)) {
+      auto &note = activeNotes.note(slot);
+      uint64_t endSample = absoluteSamples;
+      if (endSample < note.startSample) {
+        noteOffLog("[NoteOff] SKIPPED: endSample=" + std::to_string(endSample) +
+                   " < startSample=" + std::to_string(note.startSample));
+        continue;
       }
+
+      note.durationSamples = endSample - note.startSample;
+      note.automationEnd =
+          (uint32_t)ccLogs[(size_t)channel].changes.size();
+      note.endVelocity = currentDynamics(note);
+
+      emitNote(TrackerEvent::Type::NoteEnded, note);
+      activeNotes.remove(slot);
+      if (activeNotes.newestOnChannel(channel) == ActiveNoteTable::kNone)
+        ccLogs[(size_t)channel].clear(); // Nothing references it any more
+      else
+        compactCcLog(channel);
+      return;
     }
 
     // No match found
     std::string dump = "[NoteOff] NO MATCH for port=" + std::to_string(port) +
                        " ch=" + std::to_string(chan) +
                        " note=" + std::to_string(noteNum) + ". Active notes:";
-    for (const auto &n : activeNotes) {
-      dump += "\n  ID=" + std::to_string(n.id()) +
-              " port=" + std::to_string(n.port()) +
-              " ch=" + std::to_string(n.channel()) +
-              " note=" + std::to_string(n.note_number()) +
-              " start=" + std::to_string(n.start_sample());
-    }
+    activeNotes.forEach([&](const TrackedNote &n) {
+      dump += "\n  ID=" + std::to_string(n.id) +
+              " port=" + std::to_string(n.port) +
+              " ch=" + std::to_string(n.channel) +
+              " note=" + std::to_string(n.noteNumber) +
+              " start=" + std::to_string(n.startSample);
+    });
     noteOffLog(dump);
   }
 };
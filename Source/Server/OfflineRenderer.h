@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../AudioSharedMemory.h"
+#include "MixerModel.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+
+namespace fiddle {
+
+/**
+ * Renders the mixer as fast as the CPU allows while the host exports
+ * (VST3 kOffline), instead of on the audio device clock.
+ *
+ * In offline mode MIDI is scheduled by host sample position rather than by
+ * arrival time plus the playback delay. The plugin sends a PROGRESS event
+ * after each block's events; this thread renders up to that position and
+ * pushes into the shared-memory ring whenever it has room. The plugin blocks
+ * until its block is in the ring, so the export runs exactly as fast as the
+ * strips render.
+ *
+ * The render position starts `latency` samples before the transport start,
+ * matching the latency the plugin reports, so exported audio lines up
+ * sample-for-sample with the score.
+ */
+class OfflineRenderer : private juce::Thread {
+public:
+  OfflineRenderer(MixerModel &mixer, AudioSharedMemory &ring)
+      : juce::Thread("OfflineRenderer"), mixer_(mixer), ring_(ring) {}
+
+  ~OfflineRenderer() override { end(); }
+
+  /// Offline transport start at host position `hostPos`.
+  void begin(uint64_t hostPos, uint64_t latencySamples) {
+    end();
+    renderPos_ = (int64_t)hostPos - (int64_t)latencySamples;
+    progress_.store(renderPos_, std::memory_order_relaxed);
+    audioYielded_.store(false, std::memory_order_relaxed);
+    active_.store(true, std::memory_order_release);
+    startThread(juce::Thread::Priority::high);
+    std::cerr << "[OfflineRenderer] Started at " << hostPos << " (latency "
+              << latencySamples << ")" << std::endl;
+  }
+
+  /// Every event before `hostPos` has been received and routed.
+  void progress(uint64_t hostPos) {
+    progress_.store((int64_t)hostPos, std::memory_order_release);
+    notify();
+  }
+
+  /// The render thread is stopped before the device callback may take the
+  /// mixer and the ring back, so they never have two users at once.
+  void end() {
+    if (!isActive())
+      return;
+    stopThread(2000);
+    active_.store(false, std::memory_order_release);
+    std::cerr << "[OfflineRenderer] Stopped at " << renderPos_ << std::endl;
+  }
+
+  bool isActive() const { return active_.load(std::memory_order_acquire); }
+
+  /// Called by the audio device callback while offline rendering is active;
+  /// the device callback must then leave the mixer and ring alone.
+  void yieldFromAudioThread() {
+    audioYielded_.store(true, std::memory_order_release);
+  }
+
+private:
+  void run() override {
+    // Let any in-flight device callback finish with the mixer and the ring
+    // (single producer) before taking over. No callbacks at all (device
+    // stopped) is fine too.
+    for (int i = 0; i < 100 && !audioYielded_.load(std::memory_order_acquire);
+         ++i)
+      juce::Thread::sleep(1);
+    // Drop what the device callback rendered ahead of the export; only now
+    // is this the ring's one producer
+    ring_.flush();
+
+    mixer_.setNonRealtime(true);
+    const int blockSize = juce::jmax(1, mixer_.getBlockSize());
+    juce::AudioBuffer<float> buffer(2, blockSize);
+
+    while (!threadShouldExit()) {
+      int64_t ready = progress_.load(std::memory_order_acquire) - renderPos_;
+      int n = (int)std::min<int64_t>(
+          {ready, (int64_t)ring_.getFreeSpace(), (int64_t)blockSize});
+      if (n <= 0) {
+        wait(1); // woken early by progress()
+        continue;
+      }
+
+      buffer.setSize(2, n, false, false, true);
+      buffer.clear();
+      // Messages are scheduled by host position, one time unit per sample
+      mixer_.processBlock(buffer, (double)renderPos_, 1.0);
+      ring_.pushAudio(buffer);
+      renderPos_ += n;
+    }
+
+    mixer_.setNonRealtime(false);
+  }
+
+  MixerModel &mixer_;
+  AudioSharedMemory &ring_;
+
+  std::atomic<bool> active_{false};
+  std::atomic<bool> audioYielded_{false};
+  std::atomic<int64_t> progress_{0};
+  int64_t renderPos_ = 0; // render thread only (while running)
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OfflineRenderer)
+};
+
+} // namespace fiddle
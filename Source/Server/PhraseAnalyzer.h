@@ -0,0 +1,70 @@
+#pragma once
+
+#include "LookaheadBuffer.h"
+#include "TrackedNote.h"
+#include "TransportClock.h"
+
+namespace fiddle {
+
+/**
+ * Classifies how each note follows on from the one before it on its
+ * channel (legato, repeated note, chord onset), tagging both notes in the
+ * lookahead buffer: the new note's transitionIn and the previous note's
+ * transitionOut.
+ *
+ * Dorico plays legato as overlapping notes, so a note that starts while its
+ * predecessor still sounds is legato, or a repeat if the pitch is the same.
+ * The tracker pairs note-offs oldest first per pitch, so overlapping
+ * repeats end in the right order.
+ *
+ * Runs as each note arrives (TrackerEventDispatcher's scanner), before the
+ * note is handled, and looks only at the note just before it: one pass, and
+ * O(log n) per note. By the time a note is handled, the lookahead has
+ * usually brought its successor too, so transitionOut is known.
+ */
+class PhraseAnalyzer {
+public:
+  /// Notes starting this close together are one chord.
+  static constexpr double kChordWindowSeconds = 0.01;
+  /// A rest longer than this starts a new phrase.
+  static constexpr double kPhraseGapSeconds = 0.5;
+
+  explicit PhraseAnalyzer(const TransportClock &clock) : clock_(clock) {}
+
+  /// `note` has just been added to `lookahead`.
+  void noteStarted(LookaheadBuffer &lookahead, const TrackedNote &note) {
+    auto *held = lookahead.find(note);
+    auto *prev = lookahead.previous(note);
+    if (held == nullptr || prev == nullptr)
+      return;
+    held->transitionIn = classify(*prev, *held);
+    prev->transitionOut = held->transitionIn;
+  }
+
+private:
+  TrackedNote::Transition classify(const TrackedNote &prev,
+                                   const TrackedNote &note) const {
+    using T = TrackedNote::Transition;
+    const uint64_t onsetGap = note.startSample - prev.startSample;
+    if (onsetGap <= clock_.samplesFor(kChordWindowSeconds))
+      return T::Chord;
+
+    const bool samePitch = prev.noteNumber == note.noteNumber;
+    // Not ended yet, as far as the tracker had got when `note` started
+    const bool sounding =
+        prev.durationSamples == 0 ||
+        prev.startSample + prev.durationSamples > note.startSample;
+    if (sounding)
+      return samePitch ? T::Repeat : T::Legato;
+
+    const uint64_t rest =
+        note.startSample - (prev.startSample + prev.durationSamples);
+    if (samePitch && rest <= clock_.samplesFor(kPhraseGapSeconds))
+      return T::Repeat;
+    return T::None;
+  }
+
+  const TransportClock &clock_;
+};
+
+} // namespace fiddle
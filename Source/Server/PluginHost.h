@@ -1,6 +1,7 @@
 #pragma once
 
 #include "PluginEditorWindow.h"
+#include "RenderConfig.h"
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <map>
 
@@ -22,6 +23,15 @@ public:
     juce::String name;
   };
 
+  /// Re-prepare every loaded plugin for the device's rate and block size;
+  /// later loads use them too. Message thread.
+  void setRenderConfig(const RenderConfig &config) {
+    config_ = config;
+    for (auto &pair : slots_)
+      if (pair.second->instance)
+        prepareInstance(*pair.second->instance, config_);
+  }
+
   /// Load a plugin from a description. Instantiation happens asynchronously.
   void loadPlugin(const juce::String &slotId,
                   const juce::PluginDescription &desc,
@@ -30,7 +40,7 @@ public:
     unloadPlugin(slotId);
 
     formatManager_.createPluginInstanceAsync(
-        desc, 44100.0, 512,
+        desc, config_.sampleRate, config_.maxBlockSize,
         [this, slotId, desc,
          onComplete](std::unique_ptr<juce::AudioPluginInstance> instance,
                      const juce::String &error) {
@@ -42,23 +52,14 @@ public:
             return;
           }
 
-          instance->prepareToPlay(44100.0, 512);
+          prepareInstance(*instance, config_);
           std::cerr << "[PluginHost] Loaded (Async): " << desc.name
                     << std::endl;
 
           auto slot = std::make_unique<Slot>();
           slot->instance = std::move(instance);
           slot->name = desc.name;
-
-          // Open editor window
-          if (auto *editor = slot->instance->createEditor()) {
-            slot->editorWindow = std::make_unique<PluginEditorWindow>(
-                desc.name, editor, [this, id = slotId]() {
-                  // Editor window was closed — just hide, don't unload
-                  std::cerr << "[PluginHost] Editor window closed for slot "
-                            << id << std::endl;
-                });
-          }
+          // Editor is NOT opened here — user opens it via showEditor().
 
           slots_[slotId] = std::move(slot);
           if (onComplete)
@@ -133,6 +134,7 @@ public:
 
 private:
   juce::AudioPluginFormatManager formatManager_;
+  RenderConfig config_;
   std::map<juce::String, std::unique_ptr<Slot>> slots_;
 };
 
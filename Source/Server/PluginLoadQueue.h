@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include <memory>
+#include <vector>
+
+namespace fiddle {
+
+/**
+ * Loads a config's plugins in the background so the app (and playback)
+ * keeps running while a large template comes up.
+ *
+ * Saved state is base64-decoded on a thread pool as soon as a job is
+ * queued. Jobs are dispatched from a message-thread timer as their state
+ * becomes ready:
+ *   - parallel jobs (sandboxed strips, each created in its own worker
+ *     process) run up to one per CPU at a time;
+ *   - serial jobs (every in-process plugin, which is created on the
+ *     message thread) start one per timer tick, so the UI stays
+ *     responsive.
+ *
+ * A job's loader receives the decoded state and applies it before the
+ * plugin goes live, so a strip never plays a block with default settings.
+ * Loaders look their target up by ID, so a strip removed mid-load is
+ * simply skipped.
+ */
+class PluginLoadQueue : private juce::Timer {
+public:
+  using Done = std::function<void(bool)>;
+  using Loader = std::function<void(juce::MemoryBlock state, Done done)>;
+
+  static constexpr int kPollMs = 5;
+
+  PluginLoadQueue()
+      : maxParallel_(juce::jmax(2, juce::SystemStats::getNumCpus())),
+        pool_(juce::jmax(1, juce::SystemStats::getNumCpus() - 1)) {}
+
+  ~PluginLoadQueue() override {
+    *alive_ = false;
+    stopTimer();
+    pool_.removeAllJobs(true, 5000);
+  }
+
+  /// Called on the message thread after each job finishes, and once more
+  /// with done == total when the batch is complete.
+  std::function<void(int done, int total, const juce::String &name)>
+      onProgress;
+
+  /// Queue a load (message thread). `name` is shown in progress reports.
+  void add(const juce::String &name, const juce::String &stateBase64,
+           bool parallel, Loader loader) {
+    auto job = std::make_shared<Job>();
+    job->name = name;
+    job->parallel = parallel;
+    job->loader = std::move(loader);
+    if (stateBase64.isEmpty()) {
+      job->decoded.store(true, std::memory_order_relaxed);
+    } else {
+      pool_.addJob([job, stateBase64] {
+        job->state.fromBase64Encoding(stateBase64);
+        job->decoded.store(true, std::memory_order_release);
+      });
+    }
+    pending_.push_back(std::move(job));
+    ++total_;
+    if (!isTimerRunning())
+      startTimer(kPollMs);
+  }
+
+  /// Drop everything not yet started; loads already running finish
+  /// unreported.
+  void cancel() {
+    pending_.clear();
+    ++generation_;
+    reset();
+  }
+
+  bool isLoading() const { return total_ > 0; }
+  int getNumDone() const { return done_; }
+  int getNumTotal() const { return total_; }
+
+private:
+  struct Job {
+    juce::String name;
+    bool parallel = false;
+    Loader loader;
+    juce::MemoryBlock state;
+    std::atomic<bool> decoded{false};
+  };
+
+  void timerCallback() override {
+    std::vector<std::shared_ptr<Job>> ready;
+    bool serialStarted = false;
+    for (auto it = pending_.begin(); it != pending_.end();) {
+      auto &job = *it;
+      bool laneFree = job->parallel
+                          ? inFlight_ + (int)ready.size() < maxParallel_
+                          : !serialBusy_ && !serialStarted;
+      if (laneFree && job->decoded.load(std::memory_order_acquire)) {
+        serialStarted |= !job->parallel;
+        ready.push_back(std::move(job));
+        it = pending_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    // Loaders may complete synchronously, so start them after the scan
+    for (auto &job : ready)
+      dispatch(job);
+    if (pending_.empty() && inFlight_ == 0 && !serialBusy_)
+      stopTimer();
+  }
+
+  void dispatch(const std::shared_ptr<Job> &job) {
+    if (job->parallel)
+      ++inFlight_;
+    else
+      serialBusy_ = true;
+    const int generation = generation_;
+    job->loader(std::move(job->state),
+                [this, alive = alive_, job, generation](bool) {
+                  if (*alive && generation == generation_)
+                    finished(*job);
+                });
+  }
+
+  void finished(const Job &job) {
+    if (job.parallel)
+      --inFlight_;
+    else
+      serialBusy_ = false;
+    ++done_;
+    if (onProgress)
+      onProgress(done_, total_, job.name);
+    if (done_ == total_)
+      reset();
+  }
+
+  void reset() {
+    stopTimer();
+    inFlight_ = 0;
+    serialBusy_ = false;
+    done_ = total_ = 0;
+  }
+
+  // Message thread only, apart from Job::state/decoded (pool -> timer)
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+  const int maxParallel_;
+  juce::ThreadPool pool_;
+  std::vector<std::shared_ptr<Job>> pending_;
+  int inFlight_ = 0;
+  bool serialBusy_ = false;
+  int done_ = 0;
+  int total_ = 0;
+  int generation_ = 0;
+};
+
+} // namespace fiddle
@@ -0,0 +1,611 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_events/juce_events.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace fiddle {
+
+/// Command-line token that starts FiddleServer as a plugin sandbox worker
+/// instead of the app (see PluginSandboxWorker).
+inline constexpr const char *kSandboxProcessId = "fiddle-plugin-sandbox";
+
+/// Either side gives up on the other after this long without a ping.
+inline constexpr int kSandboxPingTimeoutMs = 4000;
+
+/**
+ * The block exchange between a sandboxed strip and its worker process,
+ * laid out in a memory-mapped file like AudioSharedMemory. One request is
+ * in flight at a time:
+ *
+ *   host:   write numSamples and events, then requestSeq = n
+ *   worker: copy the events out, acceptedSeq = n, render, write audio,
+ *           then doneSeq = n
+ *
+ * The host only rewrites the request once acceptedSeq has caught up, so a
+ * late worker never reads a half-written block. A worker adopts whatever
+ * requestSeq it finds when it starts, so a restarted one picks up cleanly.
+ */
+struct SandboxBlock {
+  static constexpr uint64_t kMagic = 0xF1DD1E5A4DB00001;
+  static constexpr int kNumChannels = 2;
+  static constexpr int kMaxSamples = 4096;
+  static constexpr int kMaxEvents = 1024;
+
+  struct Event {
+    int32_t sampleOffset;
+    uint8_t data[3];
+    uint8_t size;
+  };
+
+  std::atomic<uint64_t> magic;
+  std::atomic<uint32_t> requestSeq;
+  std::atomic<uint32_t> acceptedSeq;
+  std::atomic<uint32_t> doneSeq;
+
+  // Request, written by the host before requestSeq
+  int32_t numSamples;
+  int32_t numEvents;
+  int32_t nonRealtime;
+  Event events[kMaxEvents];
+
+  // Reply, written by the worker before doneSeq
+  float audio[kNumChannels][kMaxSamples];
+};
+
+/// Maps one SandboxBlock. The host creates the file (and deletes it when
+/// done); the worker maps the same file by token.
+class SandboxMemory {
+public:
+  SandboxMemory(const juce::String &token, bool create)
+      : token_(token), owner_(create) {
+    auto dir = juce::File::getSpecialLocation(
+                   juce::File::userApplicationDataDirectory)
+                   .getChildFile("Caches")
+                   .getChildFile("Fiddle");
+    file_ = dir.getChildFile("sandbox_" + token + ".mmap");
+    const auto size = (juce::int64)sizeof(SandboxBlock);
+
+    if (owner_) {
+      dir.createDirectory();
+      file_.deleteFile();
+      juce::FileOutputStream out(file_);
+      if (!out.openedOk()) {
+        std::cerr << "[Sandbox] Could not create " << file_.getFullPathName()
+                  << std::endl;
+        return;
+      }
+      out.setPosition(size - 1);
+      out.writeByte(0);
+      out.flush();
+    }
+
+    map_ = std::make_unique<juce::MemoryMappedFile>(
+        file_, juce::Range<juce::int64>(0, size),
+        juce::MemoryMappedFile::readWrite, false);
+    if (map_->getData() == nullptr)
+      return;
+
+    block_ = static_cast<SandboxBlock *>(map_->getData());
+    if (owner_) {
+      block_->requestSeq.store(0, std::memory_order_relaxed);
+      block_->acceptedSeq.store(0, std::memory_order_relaxed);
+      block_->doneSeq.store(0, std::memory_order_relaxed);
+      block_->magic.store(SandboxBlock::kMagic, std::memory_order_release);
+    }
+  }
+
+  ~SandboxMemory() {
+    map_.reset();
+    if (owner_)
+      file_.deleteFile();
+  }
+
+  const juce::String &getToken() const { return token_; }
+
+  /// The mapped block, or nullptr if mapping failed.
+  SandboxBlock *get() const {
+    return block_ != nullptr && block_->magic.load(std::memory_order_acquire) ==
+                                    SandboxBlock::kMagic
+               ? block_
+               : nullptr;
+  }
+
+private:
+  juce::String token_;
+  bool owner_;
+  juce::File file_;
+  std::unique_ptr<juce::MemoryMappedFile> map_;
+  SandboxBlock *block_ = nullptr;
+};
+
+/**
+ * Stands in for a VST3 instrument that runs in its own worker process, so a
+ * crashing or hanging sample library only takes down its own strip.
+ *
+ * To MixerStrip this is an ordinary stereo instrument. processBlock() hands
+ * the block's MIDI to the worker through a SandboxBlock and waits for the
+ * audio until the mix's deadline for the block (setBlockDeadline()); a late
+ * block is output as silence instead of stalling the mix. MIDI that never
+ * reached the worker is carried into the next block, up to one block's
+ * worth of events (see carry()).
+ *
+ * A supervisor thread relaunches the worker when the connection drops
+ * (crash, or no ping for kSandboxPingTimeoutMs) or when blocks keep missing
+ * their deadline for kStallSeconds, and reloads the plugin with the last
+ * state the host saw. Control traffic (load, prepare, state, editor) goes
+ * over the ChildProcessCoordinator pipe as ValueTrees. The worker also
+ * reports edits made in its editor, which reach this instance's listeners
+ * as audioProcessorChanged().
+ */
+class SandboxedPluginInstance : public juce::AudioPluginInstance {
+public:
+  using Callback = std::function<void(
+      std::unique_ptr<juce::AudioPluginInstance>, const juce::String &)>;
+
+  static constexpr double kDeadlineFraction = 0.8;
+  static constexpr double kOfflineDeadlineSeconds = 10.0;
+  static constexpr double kStallSeconds = 2.0;
+  static constexpr int kMaxRestarts = 5;
+  static constexpr int kLoadTimeoutMs = 60000;
+  static constexpr int kRpcTimeoutMs = 5000;
+
+  /// Launch a worker and load `desc` into it off the message thread, with
+  /// `state` (if any) restored inside the worker; calls back on the message
+  /// thread like createPluginInstanceAsync().
+  static void createAsync(const juce::PluginDescription &desc,
+                          double sampleRate, int blockSize,
+                          const juce::MemoryBlock &state, Callback callback) {
+    juce::Thread::launch([desc, sampleRate, blockSize, state, callback] {
+      auto instance = std::make_unique<SandboxedPluginInstance>(desc);
+      instance->sampleRate_ = sampleRate;
+      instance->blockSize_ = blockSize;
+      instance->lastState_ = state;
+      juce::String error;
+      if (!instance->start(error))
+        instance.reset();
+      auto *raw = instance.release();
+      juce::MessageManager::callAsync([raw, error, callback] {
+        callback(std::unique_ptr<juce::AudioPluginInstance>(raw), error);
+      });
+    });
+  }
+
+  explicit SandboxedPluginInstance(const juce::PluginDescription &desc)
+      : juce::AudioPluginInstance(BusesProperties().withOutput(
+            "Output", juce::AudioChannelSet::stereo(), true)),
+        desc_(desc), memory_(juce::Uuid().toString(), true),
+        supervisor_(*this) {
+    supervisor_.startThread();
+  }
+
+  ~SandboxedPluginInstance() override {
+    shuttingDown_.store(true, std::memory_order_release);
+    replyEvent_.signal(); // Cut short a load the supervisor is waiting on
+    supervisor_.signalThreadShouldExit();
+    supervisor_.notify();
+    supervisor_.stopThread(kLoadTimeoutMs);
+    std::lock_guard<std::mutex> lock(connectionMutex_);
+    connection_.reset(); // Kills the worker
+  }
+
+  /// Ask the worker to open the plugin's editor in its own window.
+  void showRemoteEditor() {
+    if (ready_.load(std::memory_order_acquire))
+      call(juce::ValueTree("showEditor"), kRpcTimeoutMs);
+  }
+
+  bool isWorkerRunning() const {
+    return ready_.load(std::memory_order_acquire);
+  }
+  uint64_t getNumMissedBlocks() const {
+    return missedBlocks_.load(std::memory_order_relaxed);
+  }
+  /// MIDI events lost because the carry-over was full.
+  uint64_t getNumDroppedEvents() const {
+    return droppedEvents_.load(std::memory_order_relaxed);
+  }
+  int getNumRestarts() const {
+    return restarts_.load(std::memory_order_relaxed);
+  }
+
+  /// The moment, in high-resolution ticks, by which the coming
+  /// processBlock() must return: the same for every sandboxed strip in the
+  /// mix (MixerModel::processBlock()). Audio thread, before each block;
+  /// without one, each chunk gets kDeadlineFraction of its own duration.
+  void setBlockDeadline(juce::int64 ticks) { blockDeadline_ = ticks; }
+
+  // ── AudioPluginInstance ──
+
+  const juce::String getName() const override { return desc_.name; }
+
+  void fillInPluginDescription(juce::PluginDescription &d) const override {
+    d = desc_;
+  }
+
+  void prepareToPlay(double sampleRate, int blockSize) override {
+    sampleRate_ = sampleRate;
+    blockSize_ = blockSize;
+    missLimit_ = juce::jmax(
+        1, (int)(kStallSeconds * sampleRate / juce::jmax(1, blockSize)));
+    if (!ready_.load(std::memory_order_acquire))
+      return;
+    juce::ValueTree message("prepare");
+    message.setProperty("sampleRate", sampleRate, nullptr);
+    message.setProperty("blockSize", blockSize, nullptr);
+    call(message, kRpcTimeoutMs);
+  }
+
+  void releaseResources() override {}
+
+  void processBlock(juce::AudioBuffer<float> &buffer,
+                    juce::MidiBuffer &midi) override {
+    buffer.clear();
+    auto *block = memory_.get();
+    if (block == nullptr || !ready_.load(std::memory_order_acquire)) {
+      numCarried_ = 0; // A restarted plugin starts from silence anyway
+      consecutiveMisses_ = 0;
+      return;
+    }
+    const int total = buffer.getNumSamples();
+    for (int start = 0; start < total; start += SandboxBlock::kMaxSamples)
+      renderChunk(*block, buffer, midi, start,
+                  juce::jmin(SandboxBlock::kMaxSamples, total - start));
+    blockDeadline_ = 0; // Used up
+  }
+
+  using juce::AudioPluginInstance::processBlock;
+
+  double getTailLengthSeconds() const override { return tailSeconds_; }
+  bool acceptsMidi() const override { return true; }
+  bool producesMidi() const override { return false; }
+
+  // The editor lives in the worker; see showRemoteEditor()
+  juce::AudioProcessorEditor *createEditor() override { return nullptr; }
+  bool hasEditor() const override { return true; }
+
+  int getNumPrograms() override { return 1; }
+  int getCurrentProgram() override { return 0; }
+  void setCurrentProgram(int) override {}
+  const juce::String getProgramName(int) override { return {}; }
+  void changeProgramName(int, const juce::String &) override {}
+
+  void getStateInformation(juce::MemoryBlock &destData) override {
+    if (ready_.load(std::memory_order_acquire)) {
+      auto reply = call(juce::ValueTree("getState"), kRpcTimeoutMs);
+      if (auto *data = reply["state"].getBinaryData()) {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        lastState_ = *data;
+      }
+    }
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    destData = lastState_;
+  }
+
+  void setStateInformation(const void *data, int sizeInBytes) override {
+    {
+      std::lock_guard<std::mutex> lock(stateMutex_);
+      lastState_.replaceAll(data, (size_t)sizeInBytes);
+    }
+    if (!ready_.load(std::memory_order_acquire))
+      return; // Applied on (re)load
+    juce::ValueTree message("setState");
+    message.setProperty("state", juce::MemoryBlock(data, (size_t)sizeInBytes),
+                        nullptr);
+    call(message, kRpcTimeoutMs);
+  }
+
+private:
+  class Connection : public juce::ChildProcessCoordinator {
+  public:
+    explicit Connection(SandboxedPluginInstance &o) : owner(o) {}
+    ~Connection() override { killWorkerProcess(); }
+
+    void handleMessageFromWorker(const juce::MemoryBlock &data) override {
+      owner.handleReply(
+          juce::ValueTree::readFromData(data.getData(), data.getSize()));
+    }
+    void handleConnectionLost() override {
+      owner.replyEvent_.signal(); // Fail a pending call now, not at timeout
+      if (owner.ready_.load(std::memory_order_acquire))
+        owner.requestRestart("worker connection lost");
+    }
+
+  private:
+    SandboxedPluginInstance &owner;
+  };
+
+  /// Relaunches the worker off the audio and message threads.
+  class Supervisor : public juce::Thread {
+  public:
+    explicit Supervisor(SandboxedPluginInstance &o)
+        : juce::Thread("PluginSandbox"), owner(o) {}
+
+    void run() override {
+      static constexpr int kRetryMs = 1000;
+      while (!threadShouldExit()) {
+        wait(-1);
+        // Logged here: requestRestart() may run on the audio thread
+        if (auto *reason = owner.restartReason_.exchange(nullptr))
+          std::cerr << "[Sandbox " << owner.desc_.name
+                    << "] Restarting worker: " << reason << std::endl;
+        while (owner.restartPending_.load(std::memory_order_acquire) &&
+               !threadShouldExit()) {
+          if (owner.restartWorker()) {
+            owner.restartPending_.store(false, std::memory_order_release);
+            break;
+          }
+          if (owner.restarts_.load() >= kMaxRestarts) {
+            std::cerr << "[Sandbox " << owner.desc_.name
+                      << "] Giving up after " << kMaxRestarts << " restarts"
+                      << std::endl;
+            return; // Leaves restartPending_ set: the strip stays silent
+          }
+          wait(kRetryMs);
+        }
+      }
+    }
+
+  private:
+    SandboxedPluginInstance &owner;
+  };
+
+  /// Launch a worker and load the plugin into it. Any thread but the
+  /// audio thread; blocks until the worker answers.
+  bool start(juce::String &error) {
+    {
+      std::lock_guard<std::mutex> lock(connectionMutex_);
+      connection_ = std::make_unique<Connection>(*this);
+      auto exe = juce::File::getSpecialLocation(
+          juce::File::currentExecutableFile);
+      if (!connection_->launchWorkerProcess(exe, kSandboxProcessId,
+                                            kSandboxPingTimeoutMs)) {
+        connection_.reset();
+        error = "could not launch the sandbox worker";
+        return false;
+      }
+    }
+
+    juce::ValueTree message("load");
+    if (auto xml = desc_.createXml())
+      message.setProperty("desc", xml->toString(), nullptr);
+    message.setProperty("sampleRate", sampleRate_, nullptr);
+    message.setProperty("blockSize", blockSize_, nullptr);
+    message.setProperty("token", memory_.getToken(), nullptr);
+    {
+      std::lock_guard<std::mutex> lock(stateMutex_);
+      if (lastState_.getSize() > 0)
+        message.setProperty("state", lastState_, nullptr);
+    }
+
+    auto reply = call(message, kLoadTimeoutMs);
+    if (!(bool)reply["ok"]) {
+      error = reply.isValid() ? reply["error"].toString()
+                              : juce::String("sandbox worker did not answer");
+      std::lock_guard<std::mutex> lock(connectionMutex_);
+      connection_.reset();
+      return false;
+    }
+    tailSeconds_ = (double)reply["tail"];
+    setLatencySamples((int)reply["latency"]);
+    ready_.store(true, std::memory_order_release);
+    std::cerr << "[Sandbox " << desc_.name << "] Worker running" << std::endl;
+    return true;
+  }
+
+  bool restartWorker() {
+    restarts_.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(connectionMutex_);
+      connection_.reset();
+    }
+    juce::String error;
+    if (start(error))
+      return true;
+    std::cerr << "[Sandbox " << desc_.name << "] Restart failed: " << error
+              << std::endl;
+    return false;
+  }
+
+  /// Any thread, including the audio thread: never blocks. `reason` must
+  /// be a string literal; the supervisor logs it.
+  void requestRestart(const char *reason) {
+    if (shuttingDown_.load(std::memory_order_acquire) ||
+        restartPending_.exchange(true, std::memory_order_acq_rel))
+      return;
+    ready_.store(false, std::memory_order_release);
+    restartReason_.store(reason);
+    supervisor_.notify();
+  }
+
+  /// Send a request and wait for the matching reply (invalid on timeout).
+  juce::ValueTree call(juce::ValueTree message, int timeoutMs) {
+    std::lock_guard<std::mutex> lock(connectionMutex_);
+    if (!connection_)
+      return {};
+    const int id = ++nextRequestId_;
+    message.setProperty("id", id, nullptr);
+    {
+      std::lock_guard<std::mutex> replyLock(replyMutex_);
+      pendingId_ = id;
+      reply_ = {};
+    }
+    replyEvent_.reset();
+    if (shuttingDown_.load(std::memory_order_acquire))
+      return {};
+    juce::MemoryOutputStream out;
+    message.writeToStream(out);
+    if (!connection_->sendMessageToWorker(out.getMemoryBlock()) ||
+        !replyEvent_.wait(timeoutMs))
+      return {};
+    std::lock_guard<std::mutex> replyLock(replyMutex_);
+    return reply_;
+  }
+
+  void handleReply(const juce::ValueTree &reply) {
+    if (reply.hasType("changed")) {
+      updateHostDisplay(ChangeDetails().withParameterInfoChanged(true));
+      return;
+    }
+    std::lock_guard<std::mutex> lock(replyMutex_);
+    if ((int)reply["id"] != pendingId_)
+      return; // Answer to a request that already timed out
+    reply_ = reply;
+    replyEvent_.signal();
+  }
+
+  /// Hand one chunk to the worker and copy its audio back (audio thread).
+  void renderChunk(SandboxBlock &block, juce::AudioBuffer<float> &buffer,
+                   const juce::MidiBuffer &midi, int start, int numSamples) {
+    const uint32_t last = block.requestSeq.load(std::memory_order_relaxed);
+    if (block.acceptedSeq.load(std::memory_order_acquire) != last) {
+      // Still reading the previous request: keep this chunk's MIDI for later
+      for (const auto m : midi)
+        if (m.samplePosition >= start &&
+            m.samplePosition < start + numSamples)
+          carry(m.data, m.numBytes);
+      noteMiss();
+      return;
+    }
+
+    int numEvents = 0;
+    auto add = [&](const juce::uint8 *data, int size, int offset) {
+      if (size < 1 || size > 3)
+        return;
+      if (numEvents == SandboxBlock::kMaxEvents) {
+        droppedEvents_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      auto &e = block.events[numEvents++];
+      e.sampleOffset = offset;
+      e.size = (uint8_t)size;
+      std::copy_n(data, size, e.data);
+    };
+    for (int i = 0; i < numCarried_; ++i)
+      add(carry_[(size_t)i].data, carry_[(size_t)i].size, 0);
+    numCarried_ = 0;
+    for (const auto m : midi)
+      if (m.samplePosition >= start && m.samplePosition < start + numSamples)
+        add(m.data, m.numBytes, m.samplePosition - start);
+    block.numEvents = numEvents;
+    block.numSamples = numSamples;
+    block.nonRealtime = isNonRealtime() ? 1 : 0;
+    const uint32_t seq = last + 1;
+    block.requestSeq.store(seq, std::memory_order_release);
+
+    const auto now = juce::Time::getHighResolutionTicks();
+    juce::int64 deadline = blockDeadline_;
+    if (isNonRealtime())
+      deadline = now + juce::Time::secondsToHighResolutionTicks(
+                           kOfflineDeadlineSeconds);
+    else if (deadline == 0)
+      deadline = now + juce::Time::secondsToHighResolutionTicks(
+                           kDeadlineFraction * numSamples / sampleRate_);
+    if (!waitFor(block, seq, deadline)) {
+      noteMiss();
+      return;
+    }
+    consecutiveMisses_ = 0;
+    const int channels =
+        juce::jmin(buffer.getNumChannels(), SandboxBlock::kNumChannels);
+    for (int ch = 0; ch < channels; ++ch)
+      buffer.copyFrom(ch, start, block.audio[ch], numSamples);
+  }
+
+  /// Keep an event for the next request the worker takes. Everything
+  /// carried lands at offset 0, so only the latest value of a controller,
+  /// pitch bend or pressure matters: a newer one replaces the older. Past
+  /// capacity (a request's worth) other events are dropped and counted, so
+  /// the audio thread never allocates.
+  void carry(const juce::uint8 *data, int size) {
+    if (size < 1 || size > 3)
+      return;
+    const juce::uint8 status = data[0];
+    const int kind = status & 0xf0;
+    const bool continuous = kind == 0xa0 || kind == 0xb0 || kind == 0xd0 ||
+                            kind == 0xe0; // poly AT, CC, pressure, bend
+    // Poly aftertouch and CC are per note/controller number
+    const bool keyed = kind == 0xa0 || kind == 0xb0;
+    if (continuous) {
+      for (int i = numCarried_ - 1; i >= 0; --i) {
+        auto &e = carry_[(size_t)i];
+        if (e.data[0] == status && e.size == size &&
+            (!keyed || e.data[1] == data[1])) {
+          std::copy_n(data, size, e.data);
+          return;
+        }
+      }
+    }
+    if (numCarried_ == (int)carry_.size()) {
+      droppedEvents_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto &e = carry_[(size_t)numCarried_++];
+    e.sampleOffset = 0;
+    e.size = (uint8_t)size;
+    std::copy_n(data, size, e.data);
+  }
+
+  static bool waitFor(const SandboxBlock &block, uint32_t seq,
+                      juce::int64 deadline) {
+    static constexpr int kSpinIterations = 2000;
+    for (int spins = 0; block.doneSeq.load(std::memory_order_acquire) != seq;
+         ++spins) {
+      if (juce::Time::getHighResolutionTicks() > deadline)
+        return false;
+      if (spins > kSpinIterations)
+        std::this_thread::yield();
+    }
+    return true;
+  }
+
+  void noteMiss() {
+    missedBlocks_.fetch_add(1, std::memory_order_relaxed);
+    if (++consecutiveMisses_ >= (isNonRealtime() ? 1 : missLimit_))
+      requestRestart("blocks keep missing their deadline");
+  }
+
+  const juce::PluginDescription desc_;
+  SandboxMemory memory_;
+
+  std::mutex connectionMutex_; // Serializes control calls; guards connection_
+  std::unique_ptr<Connection> connection_;
+  int nextRequestId_ = 0;
+
+  std::mutex replyMutex_;
+  int pendingId_ = 0;
+  juce::ValueTree reply_;
+  juce::WaitableEvent replyEvent_;
+
+  std::mutex stateMutex_;
+  juce::MemoryBlock lastState_; // Reloaded into a restarted worker
+
+  std::atomic<bool> ready_{false};
+  std::atomic<bool> restartPending_{false};
+  std::atomic<const char *> restartReason_{nullptr}; // for the supervisor
+  std::atomic<bool> shuttingDown_{false};
+  std::atomic<int> restarts_{0};
+  std::atomic<uint64_t> missedBlocks_{0};
+  std::atomic<uint64_t> droppedEvents_{0};
+
+  double sampleRate_ = 44100.0;
+  int blockSize_ = 512;
+  double tailSeconds_ = 0.0;
+  int missLimit_ = 172;
+
+  // Audio thread only
+  juce::int64 blockDeadline_ = 0; // 0 = none set
+  std::array<SandboxBlock::Event, SandboxBlock::kMaxEvents> carry_;
+  int numCarried_ = 0;
+  int consecutiveMisses_ = 0;
+
+  Supervisor supervisor_; // Stopped by the destructor before the rest goes
+};
+
+} // namespace fiddle
@@ -0,0 +1,282 @@
+#pragma once
+
+#include "PluginEditorWindow.h"
+#include "PluginSandbox.h"
+#include "RenderConfig.h"
+#include <atomic>
+#include <iostream>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_events/juce_events.h>
+#include <memory>
+
+namespace fiddle {
+
+/**
+ * The worker side of a SandboxedPluginInstance: FiddleServer started with
+ * kSandboxProcessId on its command line hosts one plugin and nothing else.
+ *
+ * Control messages arrive on the pipe and are handled on the message thread
+ * (plugins expect to be created and edited there). A realtime render thread
+ * polls the SandboxBlock for requests, spinning briefly after each block
+ * like the strip render pool. The process quits when the host goes away.
+ */
+class PluginSandboxWorker : public juce::ChildProcessWorker {
+public:
+  PluginSandboxWorker() {
+    formatManager_.addFormat(new juce::VST3PluginFormat());
+  }
+
+  ~PluginSandboxWorker() override {
+    *alive_ = false;
+    renderer_.stopThread(1000);
+    if (plugin_)
+      plugin_->removeListener(&changes_);
+    editorWindow_.reset(); // before the plugin it edits
+    plugin_.reset();
+  }
+
+  void handleMessageFromCoordinator(const juce::MemoryBlock &data) override {
+    auto message =
+        juce::ValueTree::readFromData(data.getData(), data.getSize());
+    juce::MessageManager::callAsync([this, alive = alive_, message] {
+      if (*alive)
+        handle(message);
+    });
+  }
+
+  void handleConnectionLost() override {
+    juce::MessageManager::callAsync(
+        [] { juce::JUCEApplicationBase::quit(); });
+  }
+
+private:
+  /// Tells the host when the plugin's settings change (its editor lives
+  /// here, out of the host's sight), at most once per kPollMs. Listener
+  /// callbacks can come from the render thread, so they only set a flag.
+  class ChangeReporter : public juce::AudioProcessorListener,
+                         private juce::Timer {
+  public:
+    static constexpr int kPollMs = 100;
+
+    explicit ChangeReporter(PluginSandboxWorker &o) : owner(o) {}
+    ~ChangeReporter() override { stopTimer(); }
+
+    void start() { startTimer(kPollMs); }
+
+    void audioProcessorParameterChanged(juce::AudioProcessor *, int,
+                                        float) override {
+      changed.store(true, std::memory_order_relaxed);
+    }
+    void audioProcessorChanged(juce::AudioProcessor *,
+                               const ChangeDetails &) override {
+      changed.store(true, std::memory_order_relaxed);
+    }
+
+  private:
+    void timerCallback() override {
+      if (changed.exchange(false, std::memory_order_relaxed))
+        owner.send(juce::ValueTree("changed"), 0);
+    }
+
+    PluginSandboxWorker &owner;
+    std::atomic<bool> changed{false};
+  };
+
+  class Renderer : public juce::Thread {
+  public:
+    explicit Renderer(PluginSandboxWorker &o)
+        : juce::Thread("SandboxRender"), owner(o) {}
+
+    void run() override {
+      static constexpr int kSpinIterations = 2000;
+      auto &block = *owner.memory_->get();
+      // Adopt whatever the host last asked for (we may be a restart)
+      uint32_t handled = block.requestSeq.load(std::memory_order_acquire);
+      block.acceptedSeq.store(handled, std::memory_order_release);
+      block.doneSeq.store(handled, std::memory_order_release);
+
+      int spins = 0;
+      while (!threadShouldExit()) {
+        const uint32_t seq = block.requestSeq.load(std::memory_order_acquire);
+        if (seq == handled) {
+          if (++spins < kSpinIterations)
+            std::this_thread::yield();
+          else
+            wait(1); // Idle: poll at 1 ms
+          continue;
+        }
+        spins = 0;
+        handled = seq;
+        owner.render(block, seq);
+      }
+    }
+
+  private:
+    PluginSandboxWorker &owner;
+  };
+
+  void handle(const juce::ValueTree &message) {
+    const int id = message["id"];
+    juce::ValueTree reply("reply");
+
+    if (message.hasType("load")) {
+      load(message, id);
+      return;
+    }
+    if (message.hasType("prepare") && plugin_) {
+      renderer_.stopThread(1000);
+      prepare((double)message["sampleRate"], (int)message["blockSize"]);
+      startRenderer();
+    } else if (message.hasType("getState") && plugin_) {
+      juce::MemoryBlock state;
+      plugin_->getStateInformation(state);
+      reply.setProperty("state", state, nullptr);
+    } else if (message.hasType("setState") && plugin_) {
+      if (auto *state = message["state"].getBinaryData())
+        plugin_->setStateInformation(state->getData(), (int)state->getSize());
+    } else if (message.hasType("showEditor") && plugin_) {
+      showEditor();
+    }
+    send(reply, id);
+  }
+
+  void load(const juce::ValueTree &message, int id) {
+    juce::PluginDescription desc;
+    auto xml = juce::parseXML(message["desc"].toString());
+    memory_ = std::make_unique<SandboxMemory>(message["token"].toString(),
+                                              false);
+    if (xml == nullptr || !desc.loadFromXml(*xml) ||
+        memory_->get() == nullptr) {
+      fail(id, "bad load request");
+      return;
+    }
+
+    const double sampleRate = message["sampleRate"];
+    const int blockSize = message["blockSize"];
+    juce::MemoryBlock state;
+    if (auto *data = message["state"].getBinaryData())
+      state = *data;
+
+    formatManager_.createPluginInstanceAsync(
+        desc, sampleRate, blockSize,
+        [this, alive = alive_, id, sampleRate, blockSize,
+         state](std::unique_ptr<juce::AudioPluginInstance> instance,
+                const juce::String &error) {
+          if (!*alive)
+            return;
+          if (!instance) {
+            fail(id, error);
+            return;
+          }
+          plugin_ = std::move(instance);
+          prepare(sampleRate, blockSize);
+          if (state.getSize() > 0)
+            plugin_->setStateInformation(state.getData(),
+                                         (int)state.getSize());
+          plugin_->addListener(&changes_);
+          changes_.start();
+          startRenderer();
+
+          std::cerr << "[SandboxWorker] Loaded " << plugin_->getName()
+                    << std::endl;
+          juce::ValueTree reply("reply");
+          reply.setProperty("ok", true, nullptr);
+          reply.setProperty("tail", plugin_->getTailLengthSeconds(), nullptr);
+          reply.setProperty("latency", plugin_->getLatencySamples(), nullptr);
+          send(reply, id);
+        });
+  }
+
+  /// Renderer stopped (or not yet started).
+  void prepare(double sampleRate, int blockSize) {
+    sampleRate_ = sampleRate;
+    blockSize_ = blockSize;
+    prepareInstance(*plugin_, {sampleRate, blockSize});
+    buffer_.setSize(juce::jmax(plugin_->getTotalNumInputChannels(),
+                               plugin_->getTotalNumOutputChannels(),
+                               SandboxBlock::kNumChannels),
+                    SandboxBlock::kMaxSamples);
+    midi_.ensureSize(SandboxBlock::kMaxEvents * 4);
+  }
+
+  void startRenderer() {
+    renderer_.startRealtimeThread(
+        juce::Thread::RealtimeOptions{}.withApproximateAudioProcessingTime(
+            blockSize_, sampleRate_));
+  }
+
+  /// Render one request (render thread).
+  void render(SandboxBlock &block, uint32_t seq) {
+    const int numSamples =
+        juce::jlimit(0, SandboxBlock::kMaxSamples, (int)block.numSamples);
+    const int numEvents =
+        juce::jlimit(0, SandboxBlock::kMaxEvents, (int)block.numEvents);
+    midi_.clear();
+    for (int i = 0; i < numEvents; ++i) {
+      const auto &e = block.events[i];
+      if (e.size >= 1 && e.size <= 3)
+        midi_.addEvent(e.data, e.size,
+                       juce::jlimit(0, juce::jmax(0, numSamples - 1),
+                                    (int)e.sampleOffset));
+    }
+    const bool nonRealtime = block.nonRealtime != 0;
+    block.acceptedSeq.store(seq, std::memory_order_release);
+
+    if (nonRealtime != plugin_->isNonRealtime())
+      plugin_->setNonRealtime(nonRealtime);
+    juce::AudioBuffer<float> view(buffer_.getArrayOfWritePointers(),
+                                  buffer_.getNumChannels(), numSamples);
+    view.clear();
+    if (numSamples > 0)
+      plugin_->processBlock(view, midi_);
+
+    const bool mono = plugin_->getTotalNumOutputChannels() == 1;
+    for (int ch = 0; ch < SandboxBlock::kNumChannels; ++ch)
+      juce::FloatVectorOperations::copy(block.audio[ch],
+                                        view.getReadPointer(mono ? 0 : ch),
+                                        numSamples);
+    block.doneSeq.store(seq, std::memory_order_release);
+  }
+
+  void showEditor() {
+    if (editorWindow_) {
+      editorWindow_->setVisible(true);
+      editorWindow_->toFront(true);
+    } else if (auto *editor = plugin_->createEditor()) {
+      editorWindow_ =
+          std::make_unique<PluginEditorWindow>(plugin_->getName(), editor);
+    }
+  }
+
+  void fail(int id, const juce::String &error) {
+    std::cerr << "[SandboxWorker] Load failed: " << error << std::endl;
+    juce::ValueTree reply("reply");
+    reply.setProperty("ok", false, nullptr);
+    reply.setProperty("error", error, nullptr);
+    send(reply, id);
+  }
+
+  void send(juce::ValueTree reply, int id) {
+    reply.setProperty("id", id, nullptr);
+    juce::MemoryOutputStream out;
+    reply.writeToStream(out);
+    sendMessageToCoordinator(out.getMemoryBlock());
+  }
+
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+  juce::AudioPluginFormatManager formatManager_;
+  std::unique_ptr<SandboxMemory> memory_;
+  std::unique_ptr<juce::AudioPluginInstance> plugin_;
+  std::unique_ptr<PluginEditorWindow> editorWindow_;
+
+  double sampleRate_ = 44100.0;
+  int blockSize_ = 512;
+
+  // Render thread (or message thread while it is stopped)
+  juce::AudioBuffer<float> buffer_;
+  juce::MidiBuffer midi_;
+  Renderer renderer_{*this};
+  ChangeReporter changes_{*this};
+};
+
+} // namespace fiddle
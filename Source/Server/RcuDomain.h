@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace fiddle {
+
+/**
+ * Minimal read-copy-update domain.
+ *
+ * Readers (the audio callback, the offline renderer, the MIDI server
+ * thread) wrap each access to RCU-published pointers in a ReadGuard. That
+ * is two atomic increments and never blocks. Writers publish a new object
+ * by atomic exchange, call synchronize(), and only then delete the old one.
+ * synchronize() waits until every reader that could still hold the old
+ * pointer has left, so reclamation always happens on the writer's thread.
+ *
+ * Readers are counted per epoch parity. synchronize() flips the epoch twice
+ * and waits for each parity to drain, which covers a reader that sampled
+ * the epoch just before a flip.
+ */
+class RcuDomain {
+public:
+  class ReadGuard {
+  public:
+    explicit ReadGuard(RcuDomain &d) : domain(d) {
+      parity = (int)(domain.epoch_.load(std::memory_order_seq_cst) & 1);
+      domain.readers_[parity].fetch_add(1, std::memory_order_seq_cst);
+    }
+    ~ReadGuard() {
+      domain.readers_[parity].fetch_sub(1, std::memory_order_release);
+    }
+    ReadGuard(const ReadGuard &) = delete;
+    ReadGuard &operator=(const ReadGuard &) = delete;
+
+  private:
+    RcuDomain &domain;
+    int parity;
+  };
+
+  ReadGuard read() { return ReadGuard(*this); }
+
+  /// Block until no reader can still see anything unpublished before this
+  /// call. Writers only; never call from inside a ReadGuard.
+  void synchronize() {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    for (int phase = 0; phase < 2; ++phase) {
+      uint64_t old = epoch_.fetch_add(1, std::memory_order_seq_cst);
+      while (readers_[old & 1].load(std::memory_order_seq_cst) != 0)
+        std::this_thread::yield();
+    }
+  }
+
+private:
+  std::atomic<uint64_t> epoch_{0};
+  std::atomic<int> readers_[2] = {{0}, {0}};
+  std::mutex writerMutex_;
+};
+
+} // namespace fiddle
@@ -0,0 +1,530 @@
+#pragma once
+
+#include "MixGeneration.h"
+#include "midi_event.pb.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace fiddle {
+
+/**
+ * Rolling cache of rendered mixer output, keyed by host sample position and
+ * a hash of the event stream that produced it.
+ *
+ * Audio is cached in fixed-size chunks. A chunk's key chains the hashes of
+ * every event received since the take (transport start/locate) began, so a
+ * chunk only matches when playback started at the same position and none of
+ * the events up to and including that chunk changed. The key also carries
+ * the mixer's MixGeneration, so any edit to the mix (faders, routing,
+ * plugins and their settings, sample rate) retires everything rendered
+ * before it. On a hit the audio thread copies the chunk out instead of
+ * running the plugins; the first miss hands back to live rendering for the
+ * rest of the take.
+ *
+ * Storage is a fixed pool of chunk slots in a memory-mapped spill file sized
+ * to the memory budget, evicted in LRU order. The audio thread never
+ * allocates or blocks: index lookups use try_lock (a contended lock is a
+ * miss), and freshly rendered chunks go to a writer thread through a
+ * lock-free FIFO.
+ */
+class RenderCache : private juce::Thread {
+public:
+  static constexpr int kChunkSamples = 4096;
+  static constexpr int kNumChannels = 2;
+  static constexpr size_t kChunkBytes =
+      sizeof(float) * kChunkSamples * kNumChannels;
+  static constexpr size_t kDefaultBudgetBytes = 256u * 1024u * 1024u;
+
+  explicit RenderCache(size_t budgetBytes = kDefaultBudgetBytes)
+      : juce::Thread("RenderCache") {
+    openSpillFile(budgetBytes);
+    staging_.resize((size_t)kChunkSamples * kNumChannels, 0.0f);
+    for (auto &p : pending_)
+      p.audio.resize((size_t)kChunkSamples * kNumChannels, 0.0f);
+    if (numSlots_ > 0)
+      startThread();
+  }
+
+  ~RenderCache() override {
+    stopThread(2000);
+    spill_.reset();
+    spillFile_.deleteFile();
+  }
+
+  /// Called when the audio device (re)starts. Chunks rendered at another
+  /// rate can never hit again (MixerModel::prepareToPlay() bumps the mix
+  /// generation), so a rate change frees their slots too.
+  void prepare(double sampleRate) {
+    if (sampleRate_.exchange(sampleRate, std::memory_order_relaxed) !=
+        sampleRate)
+      clearRequested_.store(true, std::memory_order_release);
+  }
+
+  //------------------------------------------------------------------------
+  // Event side (MIDI/TCP thread)
+  //------------------------------------------------------------------------
+
+  /// Transport started or located. Audio for `hostPos` will be rendered at
+  /// `renderStartMs` (Time::getMillisecondCounterHiRes clock), i.e. after the
+  /// playback delay.
+  void beginTake(uint64_t hostPos, double renderStartMs, int delayMs) {
+    for (auto &h : eventHashes_)
+      h.store(0, std::memory_order_relaxed);
+
+    // Chunk N's events must all have arrived before chunk N is rendered.
+    double delaySamples =
+        delayMs * sampleRate_.load(std::memory_order_relaxed) / 1000.0;
+    takeHostPos_.store(hostPos, std::memory_order_relaxed);
+    takeStartMs_.store(renderStartMs, std::memory_order_relaxed);
+    takeActive_.store(delaySamples >= kChunkSamples,
+                      std::memory_order_relaxed);
+    takeGeneration_.fetch_add(1, std::memory_order_release);
+  }
+
+  /// Transport stopped.
+  void endTake() {
+    takeActive_.store(false, std::memory_order_relaxed);
+    takeGeneration_.fetch_add(1, std::memory_order_release);
+  }
+
+  /// Fold an incoming event into the hash of the chunk it plays in.
+  void addEvent(const fiddle::MidiEvent &event) {
+    if (!event.has_host_sample_position() || event.has_transport() ||
+        event.has_load_config())
+      return;
+
+    // The in-block offset depends on the host's block size, not the music
+    fiddle::MidiEvent copy(event);
+    copy.clear_timestamp_samples();
+    std::string bytes = copy.SerializeAsString();
+
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (unsigned char c : bytes) {
+      h ^= c;
+      h *= 1099511628211ull;
+    }
+
+    uint64_t chunk = event.host_sample_position() / kChunkSamples;
+    // Summed, so events within a chunk may arrive in any order
+    eventHashes_[chunk % kHashRing].fetch_add(mix(h, chunk),
+                                              std::memory_order_relaxed);
+  }
+
+  uint64_t getHitCount() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t getMissCount() const {
+    return misses_.load(std::memory_order_relaxed);
+  }
+
+  //------------------------------------------------------------------------
+  // Audio thread
+  //------------------------------------------------------------------------
+
+  /// Fill `buffer` from the cache and return true, or call `render(buffer)`,
+  /// record the result, and return false. `mix` is the mixer's generation:
+  /// only chunks rendered under its current value are served.
+  template <typename RenderFn>
+  bool process(juce::AudioBuffer<float> &buffer, double currentTime,
+               const MixGeneration &mix, RenderFn &&render) {
+    syncTake(currentTime);
+
+    if (numSlots_ == 0 || !take_.active || take_.renderPos < 0) {
+      render(buffer);
+      return false;
+    }
+
+    const uint64_t mixGeneration = mix.get();
+    bool hit = !take_.missed && tryServe(buffer, mixGeneration);
+    if (hit) {
+      take_.stagingChunk = -1; // nothing rendered, nothing to record
+      hits_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      take_.missed = true;
+      render(buffer);
+      // An edit during the render leaves this block neither mix
+      if (mix.get() == mixGeneration)
+        record(buffer, mixGeneration);
+      else
+        take_.stagingChunk = -1;
+      misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    take_.renderPos += buffer.getNumSamples();
+    renderPos_.store(take_.renderPos, std::memory_order_relaxed);
+    return hit;
+  }
+
+private:
+  static constexpr int kHashRing = 256;   // chunks of event lookahead
+  static constexpr int kNumPending = 16;  // chunks in flight to the writer
+  static constexpr int kPrefetchChunks = 8;
+
+  static uint64_t mix(uint64_t a, uint64_t b) {
+    uint64_t z = a ^ (b + 0x9E3779B97F4A7C15ull + (a << 6) + (a >> 2));
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // ── Audio-thread take state ──
+
+  struct TakeState {
+    uint32_t generation = 0;
+    bool active = false;
+    bool missed = false; // once live, stay live for the rest of the take
+    uint64_t hostPos = 0;
+    double startMs = 0.0;
+    int64_t renderPos = -1; // host position of the next rendered sample
+    int64_t chainChunk = -1;
+    uint64_t chain = 0;
+    int64_t stagingChunk = -1;
+    int stagingFill = 0;
+    uint64_t stagingChain = 0;
+    uint64_t stagingMix = 0; // mix generation the staged chunk started under
+  };
+
+  void syncTake(double currentTime) {
+    uint32_t gen = takeGeneration_.load(std::memory_order_acquire);
+    if (gen != take_.generation) {
+      take_ = TakeState();
+      take_.generation = gen;
+      take_.active = takeActive_.load(std::memory_order_relaxed);
+      take_.hostPos = takeHostPos_.load(std::memory_order_relaxed);
+      take_.startMs = takeStartMs_.load(std::memory_order_relaxed);
+      renderPos_.store(-1, std::memory_order_relaxed);
+    }
+
+    if (take_.active && take_.renderPos < 0 && currentTime >= take_.startMs) {
+      double sr = sampleRate_.load(std::memory_order_relaxed);
+      take_.renderPos = (int64_t)take_.hostPos +
+                        (int64_t)((currentTime - take_.startMs) * sr / 1000.0);
+      take_.chain = mix(0xF1DD1Eull, take_.hostPos);
+      take_.chainChunk = (int64_t)(take_.hostPos / kChunkSamples) - 1;
+    }
+  }
+
+  /// Chained event hash up to and including `chunk`. Calls are monotonic.
+  uint64_t chainFor(int64_t chunk) {
+    while (take_.chainChunk < chunk) {
+      ++take_.chainChunk;
+      auto &slot = eventHashes_[(size_t)(take_.chainChunk % kHashRing)];
+      // Reset so the slot can be reused kHashRing chunks later
+      take_.chain = mix(take_.chain, slot.exchange(0, std::memory_order_relaxed));
+    }
+    return take_.chain;
+  }
+
+  /// Index key of `chunk` under the take's event chain and `mixGeneration`.
+  uint64_t keyFor(int64_t chunk, uint64_t mixGeneration) {
+    return mix(mix((uint64_t)chunk, chainFor(chunk)), mixGeneration);
+  }
+
+  bool tryServe(juce::AudioBuffer<float> &buffer, uint64_t mixGeneration) {
+    std::unique_lock<std::mutex> lock(indexMutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+      return false;
+
+    struct Span {
+      int slot, offset, len;
+    };
+    std::array<Span, 8> spans;
+    int numSpans = 0;
+
+    const int n = buffer.getNumSamples();
+    for (int done = 0; done < n;) {
+      int64_t pos = take_.renderPos + done;
+      int64_t chunk = pos / kChunkSamples;
+      int offset = (int)(pos % kChunkSamples);
+      int len = std::min(n - done, kChunkSamples - offset);
+
+      auto it = index_.find(keyFor(chunk, mixGeneration));
+      if (it == index_.end() || numSpans == (int)spans.size())
+        return false;
+      spans[(size_t)numSpans++] = {it->second, offset, len};
+      done += len;
+    }
+
+    int done = 0;
+    for (int i = 0; i < numSpans; ++i) {
+      const auto &s = spans[(size_t)i];
+      const float *src = slotData(s.slot);
+      for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
+        if (ch < kNumChannels)
+          buffer.copyFrom(ch, done, src + ch * kChunkSamples + s.offset,
+                          s.len);
+        else
+          buffer.clear(ch, done, s.len);
+      }
+      touch(s.slot);
+      done += s.len;
+    }
+    return true;
+  }
+
+  void record(const juce::AudioBuffer<float> &buffer, uint64_t mixGeneration) {
+    // The mix changed since the staged chunk began: drop what it holds
+    if (take_.stagingMix != mixGeneration)
+      take_.stagingChunk = -1;
+
+    const int n = buffer.getNumSamples();
+    for (int done = 0; done < n;) {
+      int64_t pos = take_.renderPos + done;
+      int64_t chunk = pos / kChunkSamples;
+      int offset = (int)(pos % kChunkSamples);
+      int len = std::min(n - done, kChunkSamples - offset);
+
+      if (offset == 0) {
+        take_.stagingChunk = chunk;
+        take_.stagingFill = 0;
+        take_.stagingChain = chainFor(chunk);
+        take_.stagingMix = mixGeneration;
+      }
+
+      // Only whole chunks are cached; a take that starts mid-chunk skips it
+      if (take_.stagingChunk == chunk && take_.stagingFill == offset) {
+        for (int ch = 0; ch < kNumChannels; ++ch) {
+          float *dst = staging_.data() + ch * kChunkSamples + offset;
+          if (ch < buffer.getNumChannels())
+            juce::FloatVectorOperations::copy(
+                dst, buffer.getReadPointer(ch, done), len);
+          else
+            juce::FloatVectorOperations::clear(dst, len);
+        }
+        take_.stagingFill += len;
+        if (take_.stagingFill == kChunkSamples) {
+          handToWriter(chunk, mix(mix((uint64_t)chunk, take_.stagingChain),
+                                  take_.stagingMix));
+          take_.stagingChunk = -1;
+        }
+      }
+      done += len;
+    }
+  }
+
+  void handToWriter(int64_t chunk, uint64_t key) {
+    int start1, size1, start2, size2;
+    fifo_.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 == 1) {
+      auto &p = pending_[(size_t)start1];
+      std::memcpy(p.audio.data(), staging_.data(), kChunkBytes);
+      p.chunk = chunk;
+      p.key = key;
+      fifo_.finishedWrite(1);
+    }
+    // FIFO full: the writer is behind, just don't cache this chunk
+  }
+
+  // ── Writer thread ──
+
+  void run() override {
+    while (!threadShouldExit()) {
+      if (clearRequested_.exchange(false, std::memory_order_acquire))
+        clearIndex();
+      drainPending();
+      prefetchUpcoming();
+      wait(5);
+    }
+  }
+
+  void drainPending() {
+    int start1, size1, start2, size2;
+    fifo_.prepareToRead(fifo_.getNumReady(), start1, size1, start2, size2);
+    for (int i = 0; i < size1; ++i)
+      commit(pending_[(size_t)(start1 + i)]);
+    for (int i = 0; i < size2; ++i)
+      commit(pending_[(size_t)(start2 + i)]);
+    fifo_.finishedRead(size1 + size2);
+  }
+
+  struct PendingChunk {
+    std::vector<float> audio;
+    int64_t chunk = 0;
+    uint64_t key = 0;
+  };
+
+  void commit(const PendingChunk &p) {
+    int slot;
+    {
+      std::lock_guard<std::mutex> lock(indexMutex_);
+      if (index_.count(p.key) > 0)
+        return;
+      slot = (usedSlots_ < numSlots_) ? usedSlots_++ : evictOldest();
+    }
+
+    // Copy outside the lock: the slot is unreachable until indexed
+    std::memcpy(slotData(slot), p.audio.data(), kChunkBytes);
+
+    std::lock_guard<std::mutex> lock(indexMutex_);
+    keys_[(size_t)slot] = p.key;
+    chunkOf_[(size_t)slot] = p.chunk;
+    index_[p.key] = slot;
+    pushFront(slot);
+  }
+
+  /// Page in slots the audio thread is about to need, so a hit never waits
+  /// on the spill file.
+  void prefetchUpcoming() {
+    int64_t pos = renderPos_.load(std::memory_order_relaxed);
+    if (pos < 0)
+      return;
+    int64_t first = pos / kChunkSamples;
+
+    std::vector<int> upcoming;
+    {
+      std::lock_guard<std::mutex> lock(indexMutex_);
+      for (int s = lruHead_; s >= 0; s = next_[(size_t)s]) {
+        int64_t c = chunkOf_[(size_t)s];
+        if (c >= first && c < first + kPrefetchChunks)
+          upcoming.push_back(s);
+      }
+    }
+
+    float sink = 0.0f;
+    for (int s : upcoming) {
+      const float *data = slotData(s);
+      for (size_t i = 0; i < kChunkBytes / sizeof(float); i += 1024)
+        sink += data[i];
+    }
+    prefetchSink_ = sink;
+  }
+
+  // ── Slot pool / LRU (guarded by indexMutex_) ──
+
+  void openSpillFile(size_t budgetBytes) {
+    auto cacheDir =
+        juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("Caches")
+            .getChildFile("Fiddle");
+    if (!cacheDir.exists())
+      cacheDir.createDirectory();
+    spillFile_ = cacheDir.getChildFile("render_cache.mmap");
+    spillFile_.deleteFile();
+
+    int slots = (int)(budgetBytes / kChunkBytes);
+    juce::int64 fileSize = (juce::int64)slots * (juce::int64)kChunkBytes;
+    if (slots <= 0)
+      return;
+
+    {
+      juce::FileOutputStream out(spillFile_);
+      if (!out.openedOk()) {
+        std::cerr << "[RenderCache] Could not create spill file" << std::endl;
+        return;
+      }
+      out.setPosition(fileSize - 1);
+      out.writeByte(0);
+      out.flush();
+    }
+
+    spill_ = std::make_unique<juce::MemoryMappedFile>(
+        spillFile_, juce::Range<juce::int64>(0, fileSize),
+        juce::MemoryMappedFile::readWrite, false);
+    if (spill_->getData() == nullptr) {
+      std::cerr << "[RenderCache] Could not map spill file" << std::endl;
+      spill_.reset();
+      return;
+    }
+
+    numSlots_ = slots;
+    keys_.assign((size_t)slots, 0);
+    chunkOf_.assign((size_t)slots, -1);
+    prev_.assign((size_t)slots, -1);
+    next_.assign((size_t)slots, -1);
+    index_.reserve((size_t)slots);
+  }
+
+  float *slotData(int slot) const {
+    return static_cast<float *>(spill_->getData()) +
+           (size_t)slot * kChunkSamples * kNumChannels;
+  }
+
+  void unlink(int s) {
+    int p = prev_[(size_t)s], n = next_[(size_t)s];
+    if (p >= 0)
+      next_[(size_t)p] = n;
+    else
+      lruHead_ = n;
+    if (n >= 0)
+      prev_[(size_t)n] = p;
+    else
+      lruTail_ = p;
+    prev_[(size_t)s] = next_[(size_t)s] = -1;
+  }
+
+  void pushFront(int s) {
+    prev_[(size_t)s] = -1;
+    next_[(size_t)s] = lruHead_;
+    if (lruHead_ >= 0)
+      prev_[(size_t)lruHead_] = s;
+    lruHead_ = s;
+    if (lruTail_ < 0)
+      lruTail_ = s;
+  }
+
+  void touch(int s) {
+    if (s == lruHead_)
+      return;
+    unlink(s);
+    pushFront(s);
+  }
+
+  /// Forget every chunk. Writer thread, so no commit is half done.
+  void clearIndex() {
+    std::lock_guard<std::mutex> lock(indexMutex_);
+    index_.clear();
+    std::fill(keys_.begin(), keys_.end(), 0);
+    std::fill(chunkOf_.begin(), chunkOf_.end(), -1);
+    std::fill(prev_.begin(), prev_.end(), -1);
+    std::fill(next_.begin(), next_.end(), -1);
+    lruHead_ = lruTail_ = -1;
+    usedSlots_ = 0;
+  }
+
+  int evictOldest() {
+    int s = lruTail_;
+    unlink(s);
+    index_.erase(keys_[(size_t)s]);
+    chunkOf_[(size_t)s] = -1;
+    return s;
+  }
+
+  juce::File spillFile_;
+  std::unique_ptr<juce::MemoryMappedFile> spill_;
+  int numSlots_ = 0;
+
+  std::mutex indexMutex_;
+  std::unordered_map<uint64_t, int> index_;
+  std::vector<uint64_t> keys_;
+  std::vector<int64_t> chunkOf_;
+  std::vector<int> prev_, next_;
+  int lruHead_ = -1, lruTail_ = -1;
+  int usedSlots_ = 0;
+
+  std::array<std::atomic<uint64_t>, kHashRing> eventHashes_{};
+  std::atomic<uint32_t> takeGeneration_{0};
+  std::atomic<bool> takeActive_{false};
+  std::atomic<uint64_t> takeHostPos_{0};
+  std::atomic<double> takeStartMs_{0.0};
+  std::atomic<double> sampleRate_{44100.0};
+  std::atomic<int64_t> renderPos_{-1};
+  std::atomic<uint64_t> hits_{0}, misses_{0};
+  std::atomic<bool> clearRequested_{false};
+
+  TakeState take_; // audio thread only
+  std::vector<float> staging_;
+
+  juce::AbstractFifo fifo_{kNumPending};
+  std::array<PendingChunk, kNumPending> pending_;
+  volatile float prefetchSink_ = 0.0f;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderCache)
+};
+
+} // namespace fiddle
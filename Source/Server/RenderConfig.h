@@ -0,0 +1,54 @@
+#pragma once
+
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+namespace fiddle {
+
+/// What the mixer renders at, taken from the audio device as it starts and
+/// pushed down to every strip, bus and plugin (MixerModel::prepareToPlay).
+///
+/// Everything with per-block buffers sizes them to maxBlockSize here, once,
+/// on the message thread. The audio thread never allocates: a device that
+/// delivers a longer block than it announced has it rendered in
+/// maxBlockSize pieces by MixerModel::processBlock().
+struct RenderConfig {
+  double sampleRate = 44100.0;
+  int maxBlockSize = 512;
+
+  static RenderConfig fromDevice(juce::AudioIODevice &device) {
+    RenderConfig config;
+    config.sampleRate = device.getCurrentSampleRate();
+    config.maxBlockSize = juce::jmax(1, device.getCurrentBufferSizeSamples());
+    return config;
+  }
+
+  bool operator==(const RenderConfig &other) const {
+    return sampleRate == other.sampleRate &&
+           maxBlockSize == other.maxBlockSize;
+  }
+  bool operator!=(const RenderConfig &other) const {
+    return !(*this == other);
+  }
+};
+
+/// Prepare a hosted plugin to render at `config`. The mix is stereo, so the
+/// plugin's main output is switched to stereo first where it supports that
+/// (some instruments come up mono or multi-channel). Message thread, while
+/// the plugin is not rendering.
+inline void prepareInstance(juce::AudioPluginInstance &instance,
+                            const RenderConfig &config) {
+  auto layout = instance.getBusesLayout();
+  const auto stereo = juce::AudioChannelSet::stereo();
+  if (!layout.outputBuses.isEmpty() &&
+      layout.outputBuses.getReference(0) != stereo) {
+    layout.outputBuses.getReference(0) = stereo;
+    if (instance.checkBusesLayoutSupported(layout)) {
+      instance.releaseResources();
+      instance.setBusesLayout(layout);
+    }
+  }
+  instance.prepareToPlay(config.sampleRate, config.maxBlockSize);
+}
+
+} // namespace fiddle
@@ -1,36 +1,102 @@
 #include "ScriptBindings.h"
+#include "ExpressionMap.h"
+#include "LookaheadBuffer.h"
+#include "TrackedNote.h"
 #include "midi_event.pb.h"
 #include <scriptstdstring.h>
+#include <vector>
 
 namespace fiddle {
 
-// Bridge functions for Protobuf access
-static uint32_t Note_GetID(const fiddle::Note *n) { return n->id(); }
-static uint32_t Note_GetNoteNumber(const fiddle::Note *n) {
-  return n->note_number();
+// Expression map that names the dimensions of script-visible notes
+static const ExpressionMap *g_expressionMap = nullptr;
+
+// Notes around a script-visible note on its channel
+static const LookaheadBuffer *g_lookahead = nullptr;
+
+// Bridge functions for note access
+static uint32_t Note_GetID(const TrackedNote *n) { return (uint32_t)n->id; }
+static uint32_t Note_GetNoteNumber(const TrackedNote *n) {
+  return n->noteNumber;
 }
-static uint32_t Note_GetChannel(const fiddle::Note *n) { return n->channel(); }
-static uint32_t Note_GetStartVelocity(const fiddle::Note *n) {
-  return n->start_velocity();
+static uint32_t Note_GetChannel(const TrackedNote *n) { return n->channel; }
+static uint32_t Note_GetStartVelocity(const TrackedNote *n) {
+  return n->startVelocity;
+}
+
+static int Note_FindDimension(const std::string &name, const TrackedNote *n) {
+  if (g_expressionMap == nullptr)
+    return -1;
+  int index =
+      g_expressionMap->findDimension(juce::String::fromUTF8(name.c_str()));
+  return n->hasDimension(index) ? index : -1;
 }
 
-static float Note_GetDimension(const std::string &name, const fiddle::Note *n) {
-  auto it = n->notation_dimensions().find(name);
-  if (it != n->notation_dimensions().end()) {
-    return it->second;
+static float Note_GetDimension(const std::string &name, const TrackedNote *n) {
+  int index = Note_FindDimension(name, n);
+  if (index >= 0) {
+    return (float)n->dimensionValues[(size_t)index];
   }
   return 0.0f;
 }
 
 static std::string Note_GetTechnique(const std::string &name,
-                                     const fiddle::Note *n) {
-  auto it = n->notation_techniques().find(name);
-  if (it != n->notation_techniques().end()) {
-    return it->second;
+                                     const TrackedNote *n) {
+  int index = Note_FindDimension(name, n);
+  if (index >= 0) {
+    const auto &techniques =
+        g_expressionMap->getDimensions()[(size_t)index].techniques;
+    auto it = techniques.find(n->dimensionValues[(size_t)index]);
+    if (it != techniques.end()) {
+      return it->second.toStdString();
+    }
   }
   return "";
 }
 
+static TrackedNote *Note_GetNext(const TrackedNote *n) {
+  return g_lookahead ? const_cast<TrackedNote *>(g_lookahead->next(*n))
+                     : nullptr;
+}
+
+static TrackedNote *Note_GetPrevious(const TrackedNote *n) {
+  return g_lookahead ? const_cast<TrackedNote *>(g_lookahead->previous(*n))
+                     : nullptr;
+}
+
+static uint32_t Note_CountWithin(double seconds, const TrackedNote *n) {
+  uint32_t count = 0;
+  if (g_lookahead)
+    g_lookahead->forEachWithin(*n, seconds,
+                               [&](const TrackedNote &) { ++count; });
+  return count;
+}
+
+static std::string Note_GetTransition(const TrackedNote *n) {
+  return transitionName(n->transitionIn);
+}
+
+static std::string Note_GetTransitionOut(const TrackedNote *n) {
+  return transitionName(n->transitionOut);
+}
+
+// A batch of subnotes: std::vector<fiddle::Subnote>, read-only
+using SubnoteBatch = std::vector<fiddle::Subnote>;
+
+static uint32_t SubnoteBatch_GetLength(const SubnoteBatch *b) {
+  return (uint32_t)b->size();
+}
+
+static fiddle::Subnote *SubnoteBatch_At(uint32_t index,
+                                        const SubnoteBatch *b) {
+  if (index >= b->size()) {
+    if (auto *ctx = asGetActiveContext())
+      ctx->SetException("Subnote index out of range");
+    return nullptr;
+  }
+  return const_cast<fiddle::Subnote *>(&(*b)[index]);
+}
+
 static uint32_t Subnote_GetID(const fiddle::Subnote *s) { return s->id(); }
 static uint32_t Subnote_GetNoteNumber(const fiddle::Subnote *s) {
   return s->note_number();
@@ -69,6 +135,23 @@ void ScriptBindings::RegisterFiddleAPI(asIScriptEngine *engine) {
   engine->RegisterObjectMethod(
       "Note", "string get_technique(const string &in) const",
       asFUNCTION(Note_GetTechnique), asCALL_CDECL_OBJLAST);
+  // Lookahead: the neighbouring notes on the same channel (null if none)
+  engine->RegisterObjectMethod("Note", "Note@ get_next() const",
+                               asFUNCTION(Note_GetNext), asCALL_CDECL_OBJLAST);
+  engine->RegisterObjectMethod("Note", "Note@ get_previous() const",
+                               asFUNCTION(Note_GetPrevious),
+                               asCALL_CDECL_OBJLAST);
+  engine->RegisterObjectMethod("Note", "uint count_within(double) const",
+                               asFUNCTION(Note_CountWithin),
+                               asCALL_CDECL_OBJLAST);
+  // "legato", "repeat", "chord" or "none": from the previous note, and into
+  // the next
+  engine->RegisterObjectMethod("Note", "string get_transition() const",
+                               asFUNCTION(Note_GetTransition),
+                               asCALL_CDECL_OBJLAST);
+  engine->RegisterObjectMethod("Note", "string get_transition_out() const",
+                               asFUNCTION(Note_GetTransitionOut),
+                               asCALL_CDECL_OBJLAST);
 
   // Register Subnote type
   engine->RegisterObjectType("Subnote", 0, asOBJ_REF | asOBJ_NOCOUNT);
@@ -90,6 +173,16 @@ void ScriptBindings::RegisterFiddleAPI(asIScriptEngine *engine) {
                                asFUNCTION(Subnote_GetIsLast),
                                asCALL_CDECL_OBJLAST);
 
+  // Register SubnoteBatch: the subnotes of one tick, for
+  // processSubnotes(SubnoteBatch@)
+  engine->RegisterObjectType("SubnoteBatch", 0, asOBJ_REF | asOBJ_NOCOUNT);
+  engine->RegisterObjectMethod("SubnoteBatch", "uint get_length() const",
+                               asFUNCTION(SubnoteBatch_GetLength),
+                               asCALL_CDECL_OBJLAST);
+  engine->RegisterObjectMethod("SubnoteBatch", "Subnote@ opIndex(uint) const",
+                               asFUNCTION(SubnoteBatch_At),
+                               asCALL_CDECL_OBJLAST);
+
   // Register Global Print function
   engine->RegisterGlobalFunction("void print(const string &in)",
                                  asFUNCTION(ScriptBindings::Print),
@@ -108,4 +201,12 @@ void SetPrintCallback(std::function<void(const std::string &)> cb) {
   g_printCallback = cb;
 }
 
+void SetScriptExpressionMap(const ExpressionMap *map) {
+  g_expressionMap = map;
+}
+
+void SetScriptLookahead(const LookaheadBuffer *lookahead) {
+  g_lookahead = lookahead;
+}
+
 } // namespace fiddle
@@ -6,6 +6,9 @@
 
 namespace fiddle {
 
+class ExpressionMap;
+class LookaheadBuffer;
+
 class ScriptBindings {
 public:
   static void RegisterFiddleAPI(asIScriptEngine *engine);
@@ -16,4 +19,10 @@ public:
 
 void SetPrintCallback(std::function<void(const std::string &)> cb);
 
+/// Names the notation dimensions scripts read with Note.get_dimension().
+void SetScriptExpressionMap(const ExpressionMap *map);
+
+/// Where Note.next, Note.previous and Note.count_within() look.
+void SetScriptLookahead(const LookaheadBuffer *lookahead);
+
 } // namespace fiddle
@@ -88,6 +88,12 @@ void ScriptEngine::execute(const std::string &functionName) {
   }
 }
 
+bool ScriptEngine::hasFunction(const std::string &functionName) const {
+  std::lock_guard<std::mutex> lock(engineMutex);
+  return module != nullptr &&
+         module->GetFunctionByDecl(functionName.c_str()) != nullptr;
+}
+
 void ScriptEngine::execute(const std::string &functionName, void *arg) {
   std::lock_guard<std::mutex> lock(engineMutex);
   if (!module)
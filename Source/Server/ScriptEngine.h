@@ -21,6 +21,9 @@ public:
   // Execute a function with one object pointer argument
   void execute(const std::string &functionName, void *arg);
 
+  // Whether the loaded script defines a function
+  bool hasFunction(const std::string &functionName) const;
+
   // Set a callback for compiler/runtime messages
   void setMessageCallback(
       std::function<void(const std::string &, bool isError)> callback) {
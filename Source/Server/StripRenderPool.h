@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace fiddle {
+
+/**
+ * Real-time work-stealing pool for rendering mixer strips in parallel.
+ *
+ * Each block, the audio thread hands run() a cost estimate per job. Jobs
+ * are dealt most-expensive-first to whichever participant (the audio thread
+ * or a worker) has the least estimated work, so each queue starts with its
+ * heaviest strip. A participant pops its own queue from the front; once it
+ * is empty it steals from the back of the others. A divisi string section
+ * no longer holds up the block while other cores sit idle after a few
+ * flutes.
+ *
+ * Queues are slices of one preallocated array. Each queue's front/back pair
+ * is packed into one atomic, so owner pops and steals are a single CAS.
+ * Nothing allocates after construction.
+ *
+ * Workers spin briefly after each block (the next one is usually a few ms
+ * away) and then sleep on an event; the audio thread only signals workers
+ * that actually went to sleep.
+ */
+class StripRenderPool {
+public:
+  static constexpr int kMaxJobs = 1024;
+
+  /// `numWorkers` threads besides the calling (audio) thread.
+  StripRenderPool(int numWorkers, double sampleRate, int blockSize) {
+    const int participants = numWorkers + 1;
+    queues_ = std::make_unique<Queue[]>((size_t)participants);
+    numQueues_ = participants;
+    load_.resize((size_t)participants);
+    queueSize_.resize((size_t)participants);
+    cursor_.resize((size_t)participants);
+    order_.resize(kMaxJobs);
+    owner_.resize(kMaxJobs);
+    slots_.resize(kMaxJobs);
+
+    for (int i = 0; i < numWorkers; ++i) {
+      auto worker = std::make_unique<Worker>(*this, i + 1);
+      worker->startRealtimeThread(
+          juce::Thread::RealtimeOptions{}.withApproximateAudioProcessingTime(
+              blockSize, sampleRate));
+      workers_.push_back(std::move(worker));
+    }
+  }
+
+  ~StripRenderPool() {
+    for (auto &w : workers_)
+      w->signalThreadShouldExit();
+    for (auto &w : workers_) {
+      w->wake.signal();
+      w->stopThread(1000);
+    }
+  }
+
+  int getNumWorkers() const { return (int)workers_.size(); }
+
+  /// Run fn(0) .. fn(count - 1) across the pool and return when all are done.
+  /// costs[i] is the expected cost of job i (any unit). Called from one
+  /// thread at a time (the audio callback).
+  template <typename Fn> void run(int count, const float *costs, Fn &fn) {
+    if (count <= 0)
+      return;
+    if (workers_.empty() || count == 1 || count > kMaxJobs) {
+      for (int i = 0; i < count; ++i)
+        fn(i);
+      return;
+    }
+
+    schedule(count, costs);
+
+    context_ = &fn;
+    invoke_ = [](void *ctx, int index) { (*static_cast<Fn *>(ctx))(index); };
+    remaining_.store(count, std::memory_order_relaxed);
+    uint32_t start = 0;
+    for (int q = 0; q < numQueues_; ++q) {
+      uint32_t end = start + (uint32_t)queueSize_[(size_t)q];
+      queues_[q].range.store(pack(start, end), std::memory_order_release);
+      start = end;
+    }
+    generation_.fetch_add(1, std::memory_order_seq_cst);
+
+    for (auto &w : workers_)
+      if (w->sleeping.exchange(false, std::memory_order_seq_cst))
+        w->wake.signal();
+
+    drain(0);
+    while (remaining_.load(std::memory_order_acquire) > 0)
+      std::this_thread::yield();
+  }
+
+private:
+  static uint64_t pack(uint32_t front, uint32_t back) {
+    return ((uint64_t)front << 32) | back;
+  }
+
+  /// Longest-processing-time-first: deal jobs in descending cost to the
+  /// least-loaded queue, then lay the queues out contiguously in slots_.
+  void schedule(int count, const float *costs) {
+    for (int i = 0; i < count; ++i)
+      order_[(size_t)i] = i;
+    std::sort(order_.begin(), order_.begin() + count,
+              [costs](int a, int b) { return costs[a] > costs[b]; });
+
+    std::fill(load_.begin(), load_.end(), 0.0f);
+    std::fill(queueSize_.begin(), queueSize_.end(), 0);
+    for (int k = 0; k < count; ++k) {
+      int job = order_[(size_t)k];
+      int q = (int)(std::min_element(load_.begin(), load_.end()) -
+                    load_.begin());
+      owner_[(size_t)k] = q;
+      // Floor keeps jobs with no history yet spread across queues
+      load_[(size_t)q] += std::max(costs[job], 1.0e-3f);
+      ++queueSize_[(size_t)q];
+    }
+
+    // Stable fill: each queue keeps descending-cost order, heaviest first
+    int start = 0;
+    for (int q = 0; q < numQueues_; ++q) {
+      cursor_[(size_t)q] = start;
+      start += queueSize_[(size_t)q];
+    }
+    for (int k = 0; k < count; ++k)
+      slots_[(size_t)cursor_[(size_t)owner_[(size_t)k]]++] = order_[(size_t)k];
+  }
+
+  /// Work through queue `self`, then steal until every queue is empty.
+  void drain(int self) {
+    for (;;) {
+      int job = popFront(self);
+      for (int i = 1; job < 0 && i < numQueues_; ++i)
+        job = stealBack((self + i) % numQueues_);
+      if (job < 0)
+        return;
+      invoke_(context_, job);
+      remaining_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+
+  int popFront(int q) {
+    auto &range = queues_[q].range;
+    uint64_t v = range.load(std::memory_order_acquire);
+    for (;;) {
+      auto front = (uint32_t)(v >> 32), back = (uint32_t)v;
+      if (front >= back)
+        return -1;
+      if (range.compare_exchange_weak(v, pack(front + 1, back),
+                                      std::memory_order_acq_rel))
+        return slots_[front];
+    }
+  }
+
+  int stealBack(int q) {
+    auto &range = queues_[q].range;
+    uint64_t v = range.load(std::memory_order_acquire);
+    for (;;) {
+      auto front = (uint32_t)(v >> 32), back = (uint32_t)v;
+      if (front >= back)
+        return -1;
+      if (range.compare_exchange_weak(v, pack(front, back - 1),
+                                      std::memory_order_acq_rel))
+        return slots_[back - 1];
+    }
+  }
+
+  struct Worker : public juce::Thread {
+    Worker(StripRenderPool &p, int queueIndex)
+        : juce::Thread("StripRender " + juce::String(queueIndex)), pool(p),
+          queue(queueIndex) {}
+
+    void run() override {
+      static constexpr int kSpinIterations = 2000;
+      uint32_t seen = pool.generation_.load(std::memory_order_acquire);
+      int spins = 0;
+
+      while (!threadShouldExit()) {
+        uint32_t gen = pool.generation_.load(std::memory_order_seq_cst);
+        if (gen != seen) {
+          seen = gen;
+          pool.drain(queue);
+          spins = 0;
+          continue;
+        }
+        if (++spins < kSpinIterations) {
+          std::this_thread::yield();
+          continue;
+        }
+
+        // Announce sleep, then re-check so a block published in between
+        // isn't missed
+        sleeping.store(true, std::memory_order_seq_cst);
+        if (pool.generation_.load(std::memory_order_seq_cst) == seen)
+          wake.wait(50);
+        sleeping.store(false, std::memory_order_relaxed);
+        spins = 0;
+      }
+    }
+
+    StripRenderPool &pool;
+    const int queue;
+    juce::WaitableEvent wake;
+    std::atomic<bool> sleeping{false};
+  };
+
+  // Own cache line each, so owners and thieves on different queues don't
+  // contend
+  struct alignas(64) Queue {
+    std::atomic<uint64_t> range{0}; // (front << 32) | back into slots_
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::unique_ptr<Queue[]> queues_;
+  int numQueues_ = 0;
+
+  // Scheduling scratch (audio thread only)
+  std::vector<float> load_;
+  std::vector<int> queueSize_;
+  std::vector<int> cursor_;
+  std::vector<int> order_;
+  std::vector<int> owner_;
+  std::vector<int> slots_;
+
+  std::atomic<int> remaining_{0};
+  std::atomic<uint32_t> generation_{0};
+  void *context_ = nullptr;
+  void (*invoke_)(void *, int) = nullptr;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StripRenderPool)
+};
+
+} // namespace fiddle
@@ -1,148 +1,284 @@
 #pragma once
 
+#include "SubnotePolicy.h"
+#include "TrackedNote.h"
 #include "midi_event.pb.h"
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <juce_core/juce_core.h>
-#include <map>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace fiddle {
 
 /**
  * Generates Subnotes from Notes.
  * Splits long notes into chunks of a specific duration.
+ *
+ * Each note is split by the SubnotePolicy of its input (port and channel),
+ * taken from the policy table when the note starts.
+ *
+ * Subnotes are delivered in batches, one per call (tick, note start, note
+ * end), so consumers pay their per-call costs (a script call, a UI update)
+ * once per batch rather than once per subnote. getSubnoteCount() over
+ * getBatchCount() is how many subnotes each of those calls now covers.
  */
 class SubnoteGenerator {
 public:
-  // Default subnote duration in seconds (configurable constant)
-  static constexpr double DEFAULT_SUBNOTE_DURATION_SECONDS = 1.0;
-
   struct Callbacks {
-    std::function<void(const fiddle::Subnote &)> onSubnoteGenerated;
-    std::function<void(const fiddle::Note &)> onNoteTimeout;
+    /// The subnotes of one call, in order. Never empty.
+    std::function<void(const std::vector<fiddle::Subnote> &)> onSubnotes;
+    std::function<void(const TrackedNote &)> onNoteTimeout;
   };
 
-  SubnoteGenerator(double sampleRate = 44100.0)
-      : sampleRate(sampleRate),
-        subnoteDurationSamples(static_cast<uint64_t>(
-            DEFAULT_SUBNOTE_DURATION_SECONDS * sampleRate)) {}
+  SubnoteGenerator(double sampleRate = 44100.0) : sampleRate(sampleRate) {}
 
   void setCallbacks(Callbacks cbs) { callbacks = std::move(cbs); }
 
-  void setSubnoteDuration(double seconds) {
+  /// Policies for notes that start from now on; sounding notes keep theirs.
+  void setPolicies(const SubnotePolicyTable &table) {
     std::lock_guard<std::mutex> lock(mutex);
-    subnoteDurationSamples = static_cast<uint64_t>(seconds * sampleRate);
+    policies = table;
   }
 
   void setSampleRate(double newRate) {
     std::lock_guard<std::mutex> lock(mutex);
-    double durationSeconds = (double)subnoteDurationSamples / sampleRate;
     sampleRate = newRate;
-    subnoteDurationSamples =
-        static_cast<uint64_t>(durationSeconds * sampleRate);
+    for (auto &[id, state] : activeNotes)
+      state.timing = timingFor(state.policy);
+    rescheduleAll();
   }
 
   /**
    * Called when a NEW note starts.
    */
-  void onNoteStarted(const fiddle::Note &note) {
+  void onNoteStarted(const TrackedNote &note) {
     std::lock_guard<std::mutex> lock(mutex);
 
     ActiveNoteState state;
     state.note = note;
     state.lastEmittedOffset = 0;
+    state.policy = policies.forInput((int)note.port, (int)note.channel - 1);
+    state.timing = timingFor(state.policy);
 
     // Emit the first subnote immediately
     emitSubnote(state, false);
 
-    activeNotes[note.id()] = state;
+    auto &stored = activeNotes[note.id];
+    stored = state;
+    schedule(stored);
+    deliver();
   }
 
   /**
    * Called when a note ends.
    */
-  void onNoteEnded(const fiddle::Note &note) {
+  void onNoteEnded(const TrackedNote &note) {
     std::lock_guard<std::mutex> lock(mutex);
 
-    auto it = activeNotes.find(note.id());
+    auto it = activeNotes.find(note.id);
     if (it != activeNotes.end()) {
       it->second.note = note;        // Update with final duration
       emitSubnote(it->second, true); // Final subnote
-      activeNotes.erase(it);
+      activeNotes.erase(it);         // Its deadline is skipped when due
+      deliver();
     }
   }
 
+  /// Subnotes and batches delivered so far. Readable from any thread.
+  uint64_t getSubnoteCount() const {
+    return subnotes_.load(std::memory_order_relaxed);
+  }
+  uint64_t getBatchCount() const {
+    return batches_.load(std::memory_order_relaxed);
+  }
+  /// Time spent in onSubnotes so far: what the delivered subnotes cost the
+  /// consumers, and so how many per second they could take.
+  double getDeliverySeconds() const {
+    return juce::Time::highResolutionTicksToSeconds(
+        deliveryTicks_.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * Forget all active notes without emitting final subnotes (transport
+   * stop/locate — the notes will never receive their note-off).
+   */
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    activeNotes.clear();
+    deadlines.clear();
+    pending.clear();
+  }
+
   /**
    * Updates the progress of time. This should be called regularly.
+   *
+   * Each note waits in a min-heap keyed by its next deadline (its next
+   * subnote boundary, or its watchdog), so a tick costs O(log n) per
+   * subnote due and nothing for the notes that aren't. Subnotes cover
+   * exact boundaries in sample time however late the tick comes.
    */
   void tick(uint64_t currentSampleTime) {
     std::lock_guard<std::mutex> lock(mutex);
 
-    std::vector<uint64_t> notesToRemove;
-    for (auto &[id, state] : activeNotes) {
-      if (currentSampleTime < state.note.start_sample())
-        continue;
+    while (!deadlines.empty() && deadlines.front().at <= currentSampleTime) {
+      const Deadline due = deadlines.front();
+      std::pop_heap(deadlines.begin(), deadlines.end(), laterFirst);
+      deadlines.pop_back();
 
-      uint64_t elapsed = currentSampleTime - state.note.start_sample();
+      auto it = activeNotes.find(due.id);
+      if (it == activeNotes.end() || it->second.deadline != due.at)
+        continue; // Ended, cleared or rescheduled since
+      auto &state = it->second;
 
-      // Watchdog: If a note lasts longer than 30 seconds without an end event,
-      // force-end it to prevent infinite subnotes.
-      if (elapsed > (30LL * sampleRate)) {
+      // Watchdog: If a note lasts longer than its policy allows without an
+      // end event, force-end it to prevent infinite subnotes.
+      if (due.at >= watchdogFor(state)) {
         // Update note duration before timing out
-        state.note.set_duration_samples(elapsed);
+        state.note.durationSamples = due.at - state.note.startSample;
         emitSubnote(state, true);
+        deliver(); // Ahead of the timeout, as it was generated
 
         if (callbacks.onNoteTimeout) {
           callbacks.onNoteTimeout(state.note);
         }
 
-        notesToRemove.push_back(id);
+        activeNotes.erase(it);
         continue;
       }
 
-      // While we have enough elapsed time to emit more subnotes
-      while (elapsed >= state.lastEmittedOffset + subnoteDurationSamples) {
-        emitSubnote(state, false);
-        // Safety Break: Don't emit more than 100 subnotes per note per tick
-        if (state.subnoteCount > 100) {
-          state.lastEmittedOffset = elapsed;
-          break;
-        }
+      // Far behind (a stalled timer, a clock jump): resume one subnote
+      // before now rather than bursting out the backlog
+      const uint64_t length = state.timing.durationSamples;
+      const uint64_t elapsed = currentSampleTime - state.note.startSample;
+      if (elapsed > state.lastEmittedOffset + kMaxLateSubnotes * length) {
+        uint64_t resume = currentSampleTime - length;
+        if (state.policy.alignToGrid)
+          resume -= resume % length;
+        state.lastEmittedOffset = resume - state.note.startSample;
       }
-    }
 
-    for (auto id : notesToRemove) {
-      activeNotes.erase(id);
+      emitSubnote(state, false);
+      schedule(state);
     }
+    deliver();
   }
 
 private:
+  // Subnotes a late tick still catches up on, per note
+  static constexpr uint64_t kMaxLateSubnotes = 100;
+
+  /// A policy in samples at the current rate.
+  struct Timing {
+    uint64_t durationSamples = 1;
+    uint64_t watchdogSamples = 1;
+  };
+
   struct ActiveNoteState {
-    fiddle::Note note;
+    TrackedNote note;
     uint64_t lastEmittedOffset;
     uint64_t subnoteCount = 0;
+    uint64_t deadline = 0; // the heap entry that is current
+    SubnotePolicy policy;
+    Timing timing;
+  };
+
+  struct Deadline {
+    uint64_t at; // session samples
+    uint64_t id;
   };
 
+  static bool laterFirst(const Deadline &a, const Deadline &b) {
+    return a.at > b.at;
+  }
+
   mutable std::mutex mutex;
   double sampleRate;
-  uint64_t subnoteDurationSamples;
+  SubnotePolicyTable policies;
   Callbacks callbacks;
 
-  std::map<uint64_t, ActiveNoteState> activeNotes;
+  std::unordered_map<uint64_t, ActiveNoteState> activeNotes;
+  std::vector<Deadline> deadlines; // min-heap on `at`
+  std::vector<fiddle::Subnote> pending; // this call's batch, reused
+  std::atomic<uint64_t> subnotes_{0}, batches_{0};
+  std::atomic<juce::int64> deliveryTicks_{0};
+
+  void deliver() {
+    if (pending.empty())
+      return;
+    subnotes_.fetch_add(pending.size(), std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    if (callbacks.onSubnotes) {
+      const auto start = juce::Time::getHighResolutionTicks();
+      callbacks.onSubnotes(pending);
+      deliveryTicks_.fetch_add(juce::Time::getHighResolutionTicks() - start,
+                               std::memory_order_relaxed);
+    }
+    pending.clear();
+  }
+
+  Timing timingFor(const SubnotePolicy &policy) const {
+    Timing t;
+    t.durationSamples = std::max<uint64_t>(
+        1, static_cast<uint64_t>(policy.durationSeconds * sampleRate));
+    t.watchdogSamples = std::max<uint64_t>(
+        1, static_cast<uint64_t>(policy.watchdogSeconds * sampleRate));
+    return t;
+  }
+
+  uint64_t watchdogFor(const ActiveNoteState &state) const {
+    return state.note.startSample + state.timing.watchdogSamples;
+  }
+
+  /// Length of the subnote starting at `offset` into the note. On the grid
+  /// it runs to the next boundary, with a sliver of under a quarter of a
+  /// subnote folded into the following one.
+  static uint64_t subnoteLength(const ActiveNoteState &state,
+                                uint64_t offset) {
+    const uint64_t length = state.timing.durationSamples;
+    if (!state.policy.alignToGrid)
+      return length;
+    const uint64_t at = state.note.startSample + offset;
+    uint64_t toBoundary = length - at % length;
+    if (toBoundary < length / 4)
+      toBoundary += length;
+    return toBoundary;
+  }
+
+  /// Queue `state`'s next deadline: the end of the subnote after the one
+  /// just emitted, or its watchdog if that comes first.
+  void schedule(ActiveNoteState &state) {
+    state.deadline =
+        std::min(state.note.startSample + state.lastEmittedOffset +
+                     subnoteLength(state, state.lastEmittedOffset),
+                 watchdogFor(state));
+    deadlines.push_back({state.deadline, state.note.id});
+    std::push_heap(deadlines.begin(), deadlines.end(), laterFirst);
+  }
+
+  /// Timings changed: every pending deadline moves.
+  void rescheduleAll() {
+    deadlines.clear();
+    for (auto &[id, state] : activeNotes)
+      schedule(state);
+  }
 
   void emitSubnote(ActiveNoteState &state, bool isLast) {
-    fiddle::Subnote sub;
-    sub.set_id(state.note.id());
-    sub.set_note_number(state.note.note_number());
-    sub.set_channel(state.note.channel());
-    sub.set_velocity(state.note.start_velocity()); // Simplified
+    pending.emplace_back();
+    auto &sub = pending.back();
+    sub.set_id(state.note.id);
+    sub.set_note_number(state.note.noteNumber);
+    sub.set_channel(state.note.channel);
+    sub.set_velocity(state.note.startVelocity); // Simplified
 
     sub.set_offset_samples(state.lastEmittedOffset);
 
-    uint64_t duration = subnoteDurationSamples;
+    uint64_t duration = subnoteLength(state, state.lastEmittedOffset);
     if (isLast) {
-      if (state.note.duration_samples() > state.lastEmittedOffset)
-        duration = state.note.duration_samples() - state.lastEmittedOffset;
+      if (state.note.durationSamples > state.lastEmittedOffset)
+        duration = state.note.durationSamples - state.lastEmittedOffset;
       else
         duration = 0;
     }
@@ -151,10 +287,6 @@ private:
     sub.set_is_first(state.subnoteCount == 0);
     sub.set_is_last(isLast);
 
-    if (callbacks.onSubnoteGenerated) {
-      callbacks.onSubnoteGenerated(sub);
-    }
-
     state.lastEmittedOffset += duration;
     state.subnoteCount++;
   }
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <juce_core/juce_core.h>
+#include <map>
+#include <optional>
+
+namespace fiddle {
+
+/// How SubnoteGenerator splits the notes of one instrument. Set per strip,
+/// per family or as the default in the config YAML (FiddleConfig), and
+/// fixed for each note when it starts.
+struct SubnotePolicy {
+  double durationSeconds = 1.0;
+  /// Put subnote boundaries on multiples of the duration along the host
+  /// timeline rather than counting from each note's start, so that with a
+  /// duration of one beat (or bar) at the piece's tempo they fall on the
+  /// beat grid.
+  bool alignToGrid = false;
+  /// A note with no note-off is ended this long after it started.
+  double watchdogSeconds = 30.0;
+
+  bool operator==(const SubnotePolicy &other) const {
+    return durationSeconds == other.durationSeconds &&
+           alignToGrid == other.alignToGrid &&
+           watchdogSeconds == other.watchdogSeconds;
+  }
+  bool operator!=(const SubnotePolicy &other) const {
+    return !(*this == other);
+  }
+};
+
+/// A strip's own subnote settings (config YAML: `subnotes`). Only the keys
+/// it sets are held, so the rest follow the strip's family policy (or the
+/// default) as that stands when policies are resolved: a strip's family is
+/// only known once the instrument list has been synced, after config load.
+struct SubnotePolicyOverride {
+  std::optional<double> durationSeconds;
+  std::optional<bool> alignToGrid;
+  std::optional<double> watchdogSeconds;
+
+  bool empty() const {
+    return !durationSeconds && !alignToGrid && !watchdogSeconds;
+  }
+
+  SubnotePolicy appliedTo(SubnotePolicy base) const {
+    if (durationSeconds)
+      base.durationSeconds = *durationSeconds;
+    if (alignToGrid)
+      base.alignToGrid = *alignToGrid;
+    if (watchdogSeconds)
+      base.watchdogSeconds = *watchdogSeconds;
+    return base;
+  }
+};
+
+/// The config's subnote policies short of per-strip ones, which live on the
+/// strips themselves (MixerStrip::subnotePolicy).
+struct SubnotePolicies {
+  SubnotePolicy defaults;
+  std::map<juce::String, SubnotePolicy> families;
+
+  const SubnotePolicy &forFamily(const juce::String &family) const {
+    auto it = families.find(family);
+    return it != families.end() ? it->second : defaults;
+  }
+};
+
+/// Policies resolved per input, indexed like the mixer's routing: port and
+/// 0-based channel as MixerModel::routeEvent() takes them.
+struct SubnotePolicyTable {
+  static constexpr int kNumPorts = 16;
+
+  SubnotePolicy fallback;
+  std::array<SubnotePolicy, kNumPorts * 16> byInput;
+
+  const SubnotePolicy &forInput(int port, int channel) const {
+    if (port < 0 || port >= kNumPorts || channel < 0 || channel >= 16)
+      return fallback;
+    return byInput[(size_t)(port * 16 + channel)];
+  }
+  SubnotePolicy *inputSlot(int port, int channel) {
+    if (port < 0 || port >= kNumPorts || channel < 0 || channel >= 16)
+      return nullptr;
+    return &byInput[(size_t)(port * 16 + channel)];
+  }
+};
+
+} // namespace fiddle
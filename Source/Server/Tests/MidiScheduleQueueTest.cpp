@@ -0,0 +1,137 @@
+// Stress test for MidiScheduleQueue: 100k events pushed out of time order
+// from a producer thread while the consumer drains the ring, then popped
+// block by block. Checks every event comes out exactly once, in time order
+// (arrival order between equal times), at the right sample offset.
+
+#include "MidiScheduleQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <juce_core/juce_core.h>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kNumEvents = 100000;
+constexpr int kBlockSize = 512;
+constexpr double kTimePerSample = 1.0; // as the offline renderer schedules
+
+int failures = 0;
+
+void check(bool ok, const juce::String &what) {
+  if (ok)
+    return;
+  if (++failures <= 20)
+    std::cerr << "[MidiScheduleQueueTest] FAIL: " << what << std::endl;
+}
+
+/// Event `id` as a 3-byte controller message: channel, controller and
+/// value carry its 18 bits.
+juce::MidiMessage messageFor(int id) {
+  return juce::MidiMessage(0xb0 | (id & 0x0f), (id >> 4) & 0x7f,
+                           (id >> 11) & 0x7f);
+}
+
+int idOf(const fiddle::ScheduledMidi &item) {
+  return (item.data[0] & 0x0f) | (item.data[1] << 4) | (item.data[2] << 11);
+}
+
+} // namespace
+
+int main() {
+  // Times are whole samples, two events on each, shuffled so they arrive
+  // far out of order
+  std::vector<int> order(kNumEvents);
+  std::iota(order.begin(), order.end(), 0);
+  juce::Random random(42);
+  for (int i = kNumEvents - 1; i > 0; --i)
+    std::swap(order[(size_t)i], order[(size_t)random.nextInt(i + 1)]);
+  std::vector<double> times(kNumEvents);
+  for (int id = 0; id < kNumEvents; ++id)
+    times[(size_t)id] = (double)(order[(size_t)id] / 2) * kTimePerSample;
+
+  // A ring smaller than the test, so the producer keeps catching up with
+  // the consumer; a heap big enough to hold every event pending at once
+  fiddle::MidiScheduleQueue queue(4096, kNumEvents);
+
+  std::atomic<bool> produced{false};
+  uint64_t refused = 0; // producer only, until joined
+  std::thread producer([&] {
+    for (int id = 0; id < kNumEvents; ++id)
+      while (!queue.push(times[(size_t)id], messageFor(id))) {
+        ++refused; // Ring full: the queue counts it; wait for the consumer
+        std::this_thread::yield();
+      }
+    produced.store(true, std::memory_order_release);
+  });
+
+  // Drain everything into the heap before popping, so no event can arrive
+  // after its block has been played
+  bool flushed = false;
+  while (!produced.load(std::memory_order_acquire)) {
+    flushed |= queue.drain();
+    std::this_thread::yield();
+  }
+  producer.join();
+  flushed |= queue.drain();
+
+  check(!flushed, "unexpected flush");
+  check(queue.getNumPending() == (size_t)kNumEvents,
+        "pending " + juce::String((int)queue.getNumPending()) +
+            ", expected " + juce::String(kNumEvents));
+
+  // Expected order: by time, then by push order
+  std::vector<int> expected(kNumEvents);
+  std::iota(expected.begin(), expected.end(), 0);
+  std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) {
+    return times[(size_t)a] < times[(size_t)b];
+  });
+
+  std::vector<bool> seen(kNumEvents, false);
+  int delivered = 0;
+  const double end = times[(size_t)expected.back()] + kTimePerSample;
+  for (double blockStart = 0.0; blockStart < end;
+       blockStart += kBlockSize * kTimePerSample) {
+    queue.popDue(blockStart + kBlockSize * kTimePerSample,
+                 [&](const fiddle::ScheduledMidi &item) {
+                   const int id = idOf(item);
+                   const juce::String tag = "event " + juce::String(id);
+                   check(id >= 0 && id < kNumEvents, tag + " out of range");
+                   if (id < 0 || id >= kNumEvents)
+                     return;
+                   check(!seen[(size_t)id], tag + " delivered twice");
+                   seen[(size_t)id] = true;
+                   check(delivered < kNumEvents &&
+                             expected[(size_t)delivered] == id,
+                         tag + " out of order at " + juce::String(delivered));
+                   // As MixerStrip::popDueMessages() places it in the block
+                   const int offset =
+                       (int)((item.time - blockStart) / kTimePerSample);
+                   check(offset >= 0 && offset < kBlockSize &&
+                             blockStart + offset * kTimePerSample ==
+                                 times[(size_t)id],
+                         tag + " at offset " + juce::String(offset));
+                   ++delivered;
+                 });
+  }
+
+  check(delivered == kNumEvents, "delivered " + juce::String(delivered) +
+                                     " of " + juce::String(kNumEvents));
+  check(queue.getNumPending() == 0, "events left pending");
+  // Only the pushes the full ring refused, each of which was retried
+  check(queue.getNumDropped() == refused,
+        "dropped " + juce::String((juce::int64)queue.getNumDropped()) +
+            ", refused " + juce::String((juce::int64)refused));
+
+  if (failures > 0) {
+    std::cerr << "[MidiScheduleQueueTest] " << failures << " failures"
+              << std::endl;
+    return 1;
+  }
+  std::cerr << "[MidiScheduleQueueTest] " << kNumEvents
+            << " events delivered in order" << std::endl;
+  return 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace fiddle {
+
+/**
+ * A note as the tracker and everything downstream of it (subnotes, scripts,
+ * routing) sees it: plain data, copied by value, never allocating. The
+ * fiddle::Note protobuf is built from it only at the edges
+ * (NoteStreamTracker::toProto()).
+ *
+ * Notation dimensions are indexed by their position in the ExpressionMap,
+ * which interns the names, so a note holds one byte per dimension rather
+ * than string-keyed maps. Technique names and default flags are looked up
+ * from the value when needed.
+ *
+ * CC automation is not stored per note. Each channel keeps one log of CC
+ * changes shared by all of its notes; a note records the CC values at its
+ * start (`seed`) and the range of that log it spans.
+ */
+struct TrackedNote {
+  static constexpr int kMaxDimensions = 16;
+
+  /// How a note follows on from its neighbour on the same channel, as
+  /// PhraseAnalyzer classifies it.
+  enum class Transition : uint8_t {
+    None,   // Detached, or the first note of a phrase
+    Legato, // Starts while the previous note still sounds
+    Repeat, // Same pitch again, overlapping or not
+    Chord,  // Starts together with the previous note
+  };
+
+  uint64_t id = 0;
+  uint64_t startSample = 0;
+  uint64_t durationSamples = 0; // set when the note ends
+  uint32_t port = 0;            // as in the protobuf: 0-based
+  uint8_t channel = 0;          // 1-16
+  uint8_t noteNumber = 0;
+  uint8_t startVelocity = 0;
+  /// Dynamics at the end: the last CC1 value for CC-dynamics notes, else the
+  /// start velocity. Set when the note ends.
+  uint8_t endVelocity = 0;
+  bool ccDynamics = false; // fiddle::Note::CC rather than VELOCITY
+
+  /// Bit i set when dimensionValues[i] holds the CC value of ExpressionMap
+  /// dimension i.
+  uint16_t dimensionsSet = 0;
+  std::array<uint8_t, kMaxDimensions> dimensionValues{};
+
+  // Automation: channel CC log entries [automationBegin, automationEnd),
+  // starting from seed snapshot `seed`. Valid on the tracker's thread while
+  // the note sounds; the tracker rebases them as it compacts the log.
+  uint32_t seed = 0;
+  uint32_t automationBegin = 0;
+  uint32_t automationEnd = 0;
+
+  // Phrase context, set by the lookahead stage: from the previous note, and
+  // into the next once that has arrived.
+  Transition transitionIn = Transition::None;
+  Transition transitionOut = Transition::None;
+
+  bool hasDimension(int index) const {
+    return index >= 0 && index < kMaxDimensions &&
+           (dimensionsSet & (1u << index)) != 0;
+  }
+  void setDimension(int index, uint8_t value) {
+    if (index < 0 || index >= kMaxDimensions)
+      return;
+    dimensionValues[(size_t)index] = value;
+    dimensionsSet |= (uint16_t)(1u << index);
+  }
+};
+
+inline const char *transitionName(TrackedNote::Transition t) {
+  switch (t) {
+  case TrackedNote::Transition::Legato:
+    return "legato";
+  case TrackedNote::Transition::Repeat:
+    return "repeat";
+  case TrackedNote::Transition::Chord:
+    return "chord";
+  default:
+    return "none";
+  }
+}
+
+/// One entry in a channel's CC log.
+struct CcChange {
+  uint64_t sample; // session samples, like TrackedNote::startSample
+  uint8_t controller;
+  uint8_t value;
+};
+
+} // namespace fiddle
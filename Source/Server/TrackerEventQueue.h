@@ -0,0 +1,251 @@
+#pragma once
+
+#include "TrackedNote.h"
+#include "midi_event.pb.h"
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <juce_core/juce_core.h>
+#include <vector>
+
+namespace fiddle {
+
+/// One thing the note tracker has to tell the rest of the app.
+struct TrackerEvent {
+  enum class Type : uint8_t { NoteStarted, NoteEnded, NoteUpdated, Midi };
+
+  Type type = Type::Midi;
+  TrackedNote note; // Note* events
+
+  // Midi: every event the tracker consumed, after its note bookkeeping
+  fiddle::MidiEvent midi;
+  uint64_t absoluteSamples = 0;
+  int oldCCValue = -1; // CC changes: the value it replaced
+
+  /// When the tracker saw it (Time::getMillisecondCounterHiRes()). Playback
+  /// is scheduled one playback delay after this, however long the event is
+  /// held for lookahead.
+  double arrivalMs = 0.0;
+};
+
+/**
+ * The note tracker's outbound queue: a single-producer, single-consumer
+ * ring between the tracker (on the MIDI server thread) and the stage that
+ * acts on its events (scripts, mixer routing, the UI), which runs on its
+ * own TrackerEventDispatcher thread. Neither side locks, so tracking keeps
+ * pace with the MIDI stream however long a script or the UI takes.
+ *
+ * Slots are allocated up front and reused; a slot's MidiEvent keeps its
+ * protobuf storage between uses. Events are never dropped: when the ring
+ * is full the tracker waits for the dispatcher to catch up.
+ *
+ * The consumer may hold events in the ring for lookahead: scanNew() shows
+ * it each event once as it arrives, and drainWhile() consumes them later.
+ */
+class TrackerEventQueue {
+public:
+  // Room for a few seconds of dense MIDI held for lookahead
+  static constexpr int kDefaultSize = 16384;
+
+  explicit TrackerEventQueue(int size = kDefaultSize)
+      : fifo_(size), slots_((size_t)size) {}
+
+  // ── Producer (tracker thread) ──
+
+  /// The next free slot, to be filled then committed with push(). Waits
+  /// while the ring is full, unless nothing consumes it any more.
+  TrackerEvent &prepare() {
+    while (fifo_.getFreeSpace() == 0) {
+      if (closed_.load(std::memory_order_acquire)) {
+        discarding_ = true;
+        return scratch_;
+      }
+      fullWaits_.fetch_add(1, std::memory_order_relaxed);
+      dataReady_.signal();
+      spaceFreed_.wait(kFullWaitMs);
+    }
+    discarding_ = false;
+    int start1, size1, start2, size2;
+    fifo_.prepareToWrite(1, start1, size1, start2, size2);
+    return slots_[(size_t)start1];
+  }
+
+  /// Publish the slot returned by prepare().
+  void push() {
+    if (discarding_)
+      return;
+    fifo_.finishedWrite(1);
+    dataReady_.signal();
+  }
+
+  // ── Consumer (dispatcher thread) ──
+
+  /// Wait until something new is queued (not yet scanned), or `timeoutMs`
+  /// passes.
+  void waitForEvents(int timeoutMs) {
+    if (fifo_.getNumReady() <= scanned_)
+      dataReady_.wait(timeoutMs);
+  }
+
+  /// Show `fn` each event queued since the last call, with its position
+  /// from the head of the queue, without consuming it.
+  template <typename Fn> int scanNew(Fn &&fn) {
+    const int ready = fifo_.getNumReady();
+    if (ready <= scanned_)
+      return 0;
+    int start1, size1, start2, size2;
+    fifo_.prepareToRead(ready, start1, size1, start2, size2);
+    const int first = scanned_;
+    for (; scanned_ < ready; ++scanned_) {
+      const int slot = scanned_ < size1 ? start1 + scanned_
+                                        : start2 + (scanned_ - size1);
+      fn(slots_[(size_t)slot], scanned_);
+    }
+    return ready - first;
+  }
+
+  /// The oldest queued event, or nullptr.
+  const TrackerEvent *peek() {
+    if (fifo_.getNumReady() == 0)
+      return nullptr;
+    int start1, size1, start2, size2;
+    fifo_.prepareToRead(1, start1, size1, start2, size2);
+    return &slots_[(size_t)start1];
+  }
+
+  /// Hand queued events to `fn`, oldest first, while `ready(event)` holds.
+  /// Returns how many.
+  template <typename Ready, typename Fn>
+  int drainWhile(Ready &&ready, Fn &&fn) {
+    int handled = 0;
+    while (const auto *e = peek()) {
+      if (!ready(*e))
+        break;
+      fn(*e);
+      fifo_.finishedRead(1);
+      scanned_ = juce::jmax(0, scanned_ - 1);
+      spaceFreed_.signal();
+      ++handled;
+    }
+    return handled;
+  }
+
+  /// Hand every queued event to `fn`, in order. Returns how many.
+  template <typename Fn> int drain(Fn &&fn) {
+    return drainWhile([](const TrackerEvent &) { return true; }, fn);
+  }
+
+  /// More than three quarters full: time to stop holding events back.
+  bool isNearlyFull() const {
+    return fifo_.getFreeSpace() < fifo_.getTotalSize() / 4;
+  }
+
+  /// The consumer has stopped: a full ring discards instead of waiting.
+  void close() {
+    closed_.store(true, std::memory_order_release);
+    spaceFreed_.signal();
+  }
+  void open() { closed_.store(false, std::memory_order_release); }
+
+  /// Times the tracker found the ring full and had to wait.
+  uint64_t getNumFullWaits() const {
+    return fullWaits_.load(std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr int kFullWaitMs = 1;
+
+  juce::AbstractFifo fifo_;
+  std::vector<TrackerEvent> slots_;
+  TrackerEvent scratch_;    // producer only
+  bool discarding_ = false; // producer only
+  int scanned_ = 0;         // consumer only: queued events already scanned
+  std::atomic<bool> closed_{false};
+  juce::WaitableEvent dataReady_;
+  juce::WaitableEvent spaceFreed_;
+  std::atomic<uint64_t> fullWaits_{0};
+};
+
+/**
+ * Runs a handler over a TrackerEventQueue on its own thread.
+ *
+ * Events can be held back for lookahead: each is shown to the scanner as
+ * soon as it is queued, but reaches the handler only once it has waited
+ * the hold time, so whatever runs in the handler can see what follows it.
+ * Transport stop/locate cuts the hold short, to go silent promptly, and so
+ * does a nearly full queue.
+ */
+class TrackerEventDispatcher : private juce::Thread {
+public:
+  using Handler = std::function<void(const TrackerEvent &)>;
+  using HoldTime = std::function<double()>; // ms
+
+  TrackerEventDispatcher(TrackerEventQueue &queue, Handler handler,
+                         Handler scanner = {}, HoldTime holdMs = {})
+      : juce::Thread("TrackerEvents"), queue_(queue),
+        handler_(std::move(handler)), scanner_(std::move(scanner)),
+        holdMs_(std::move(holdMs)) {}
+
+  ~TrackerEventDispatcher() override { stop(); }
+
+  void start() {
+    queue_.open();
+    startThread();
+  }
+  void stop() {
+    stopThread(2000);
+    queue_.close();
+  }
+
+private:
+  static constexpr int kIdleWaitMs = 50;
+
+  static bool cutsHold(const TrackerEvent &e) {
+    if (e.type != TrackerEvent::Type::Midi || !e.midi.has_transport())
+      return false;
+    const auto type = e.midi.transport().type();
+    return type == fiddle::MidiEvent_TransportEvent_Type_STOP ||
+           type == fiddle::MidiEvent_TransportEvent_Type_LOCATE;
+  }
+
+  void run() override {
+    int waitMs = kIdleWaitMs;
+    while (!threadShouldExit()) {
+      queue_.waitForEvents(waitMs);
+      queue_.scanNew([this](const TrackerEvent &e, int position) {
+        if (scanner_)
+          scanner_(e);
+        if (cutsHold(e))
+          releaseThrough_ = position + 1;
+      });
+
+      const double hold = holdMs_ ? holdMs_() : 0.0;
+      const double now = juce::Time::getMillisecondCounterHiRes();
+      queue_.drainWhile(
+          [&](const TrackerEvent &e) {
+            if (releaseThrough_ > 0) {
+              --releaseThrough_;
+              return true;
+            }
+            return e.arrivalMs + hold <= now || queue_.isNearlyFull();
+          },
+          handler_);
+
+      // Sleep until the oldest held event is due
+      waitMs = kIdleWaitMs;
+      if (const auto *next = queue_.peek())
+        waitMs = juce::jlimit(
+            1, kIdleWaitMs,
+            (int)std::ceil(next->arrivalMs + hold -
+                           juce::Time::getMillisecondCounterHiRes()));
+    }
+  }
+
+  TrackerEventQueue &queue_;
+  Handler handler_;
+  Handler scanner_;
+  HoldTime holdMs_;
+  int releaseThrough_ = 0; // queued events to release regardless of hold
+};
+
+} // namespace fiddle
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <juce_core/juce_core.h>
+#include <mutex>
+
+namespace fiddle {
+
+/**
+ * The session's clock, in host samples: the same timeline as the
+ * host_sample_position on incoming events, so note times, CC automation and
+ * subnote emission all agree on where "now" is.
+ *
+ * The clock is anchored to a host position and the wall time it was seen
+ * at, and interpolates between anchors at the device sample rate. Transport
+ * start/locate/stop re-anchor it outright; every other event stamped with a
+ * host position re-syncs it, so it never drifts more than one event away
+ * from the host. Reads between a sync and the next locate never go
+ * backwards: if the host turns out to be behind the interpolation, the
+ * clock holds until it catches up.
+ *
+ * With no transport (live input while stopped, or a host that sends no
+ * positions) the clock free-runs from its first read, as the old
+ * wall-clock session time did.
+ *
+ * Written by the note tracker's thread, read from any thread.
+ */
+class TransportClock {
+public:
+  /// Device sample rate: assumed to be the host's too, as RenderCache does.
+  void setSampleRate(double rate) {
+    if (rate <= 0)
+      return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double ms = juce::Time::getMillisecondCounterHiRes();
+    anchorSamples_ = positionAt(ms); // No jump at the change
+    anchorMs_ = ms;
+    sampleRate_ = rate;
+  }
+
+  double getSampleRate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sampleRate_;
+  }
+
+  /// Samples in `seconds` at the current rate.
+  uint64_t samplesFor(double seconds) const {
+    return (uint64_t)(seconds * getSampleRate());
+  }
+
+  /// Transport started, or jumped, to `hostSamples`.
+  void locate(uint64_t hostSamples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    anchor(hostSamples);
+    lastRead_ = hostSamples;
+    playing_ = true;
+  }
+
+  /// Transport stopped at `hostSamples`. The clock keeps running from there
+  /// so notes played live while stopped still age.
+  void stop(uint64_t hostSamples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    anchor(hostSamples);
+    lastRead_ = hostSamples;
+    playing_ = false;
+  }
+
+  /// An event stamped with the host position `hostSamples`.
+  void sync(uint64_t hostSamples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    anchor(hostSamples);
+  }
+
+  /// The current host position, interpolated from the last anchor.
+  uint64_t now() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double ms = juce::Time::getMillisecondCounterHiRes();
+    if (anchorMs_ < 0)
+      anchorMs_ = ms; // Free-run from the first read
+    lastRead_ = juce::jmax(lastRead_, positionAt(ms));
+    return lastRead_;
+  }
+
+  bool isPlaying() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return playing_;
+  }
+
+private:
+  void anchor(uint64_t hostSamples) {
+    anchorSamples_ = hostSamples;
+    anchorMs_ = juce::Time::getMillisecondCounterHiRes();
+  }
+
+  uint64_t positionAt(double ms) const {
+    if (anchorMs_ < 0 || ms <= anchorMs_)
+      return anchorSamples_;
+    return anchorSamples_ +
+           (uint64_t)((ms - anchorMs_) * sampleRate_ / 1000.0);
+  }
+
+  mutable std::mutex mutex_;
+  double sampleRate_ = 44100.0;
+  uint64_t anchorSamples_ = 0;
+  mutable double anchorMs_ = -1.0; // < 0: not started
+  mutable uint64_t lastRead_ = 0;
+  bool playing_ = false;
+};
+
+} // namespace fiddle
@@ -16,6 +16,7 @@ interface Window {
     };
     addLogMessage: (msg: string, isError?: boolean) => void;
     updateNoteState: (noteData: any, status: string) => void;
+    updateSubnotes: (ids: number[]) => void;
     pushMidiEvent: (event: any) => void;
     setHeartbeat: (val: number) => void;
     setServerVersion: (ver: string) => void;
@@ -18,15 +18,21 @@ void processNote(Note@ note) {
     }
 }
 
-void processSubnote(Subnote@ subnote) {
-    if (subnote.get_is_first()) {
-        print("Subnote Sequence Start: " + subnote.get_note_number());
+// Called once per batch of subnotes (every server tick that produced any).
+// A script that defines only processSubnote(Subnote@) is called per subnote
+// instead.
+void processSubnotes(SubnoteBatch@ batch) {
+    for (uint i = 0; i < batch.length; i++) {
+        Subnote@ subnote = batch[i];
+        if (subnote.get_is_first()) {
+            print("Subnote Sequence Start: " + subnote.get_note_number());
+        }
+        // Periodic processing logic goes here
+        // Access subnote properties registered in ScriptBindings
+        uint id = subnote.get_id();
+        uint pitch = subnote.get_note_number();
+        float velocity = subnote.get_velocity();
+
+        // Logic can be added here to transform the stream
     }
-    // Periodic processing logic goes here
-    // Access subnote properties registered in ScriptBindings
-    uint id = subnote.get_id();
-    uint pitch = subnote.get_note_number();
-    float velocity = subnote.get_velocity();
-    
-    // Logic can be added here to transform the stream
 }